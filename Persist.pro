@@ -17,7 +17,10 @@ SOURCES += \
     src/CodeGenerator_Java.cpp \
     src/CodeGenerator_SQL.cpp \
     src/DataModel.cpp \
+    src/ModelCache.cpp \
+    src/OutputFile.cpp \
     src/Processor.cpp \
+    src/ThreadPool.cpp \
     src/main.cpp \
     tests/TestDataModel.cpp \
     tests/TestDatabase.cpp \
@@ -31,7 +34,10 @@ HEADERS += \
     src/CodeGenerator_Java.h \
     src/CodeGenerator_SQL.h \
     src/DataModel.h \
+    src/ModelCache.h \
+    src/OutputFile.h \
     src/Processor.h \
+    src/ThreadPool.h \
     tests/TestDataModel.h \
     tests/TestDatabase.h \
     tests/UnitTesting.h \
@@ -0,0 +1,5 @@
+#include "BuildStamp.h"
+
+const char * buildStamp() {
+    return __DATE__ " " __TIME__;
+}
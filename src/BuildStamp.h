@@ -0,0 +1,8 @@
+#pragma once
+
+/**
+ * Identifies this build of DataModeler. The caches fold it into their keys, so a
+ * new binary never trusts output or snapshots written by an old one. The Makefile
+ * recompiles BuildStamp.cpp whenever any other object changes.
+ */
+const char * buildStamp();
@@ -1,6 +1,377 @@
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+
+#include "BuildStamp.h"
 #include "CodeGenerator.h"
+#include "ThreadPool.h"
+
+using std::endl;
+using std::string;
+using Table = DataModel::Table;
 
 CodeGenerator::CodeGenerator(const std::string &_name, DataModel &m, DataModel::Generator::Pointer genInfo)
     : model(m), generatorInfo(genInfo), name(_name)
 {
 }
+
+/**
+ * Call fn for each table. With a thread pool the tables run in parallel, so fn
+ * must only write files of its own.
+ *
+ * We skip a table if nothing its output depends on has changed since the last
+ * run, according to the cache in the output directory, and the files it wrote
+ * then are all still there. Use force to ignore the cache.
+ */
+void CodeGenerator::forEachTable(const std::function<void(const Table::Pointer &)> &fn) {
+    const Table::Vector &tables = model.getTables();
+    std::unordered_map<string, TableCacheEntry> cache = force
+        ? std::unordered_map<string, TableCacheEntry>{}
+        : readTableCache();
+    std::vector<TableCacheEntry> entries(tables.size());
+
+    auto generateOne = [&](size_t index) {
+        const Table::Pointer &table = tables[index];
+        TableCacheEntry &entry = entries[index];
+        entry.hash = tableHash(*table);
+
+        auto it = cache.find(table->getName());
+        if (it != cache.end() && it->second.hash == entry.hash) {
+            std::error_code error;
+            const std::vector<string> &fileNames = it->second.fileNames;
+            if (std::all_of(fileNames.begin(), fileNames.end(),
+                    [&](const string &fileName) { return std::filesystem::exists(fileName, error); }))
+            {
+                entry.fileNames = fileNames;
+                return;
+            }
+        }
+
+        OutputFile::Recorder recorder { entry.fileNames };
+        fn(table);
+    };
+
+    if (threadPool == nullptr) {
+        for (size_t index = 0; index < tables.size(); ++index) {
+            generateOne(index);
+        }
+    }
+    else {
+        threadPool->forEach(tables.size(), generateOne);
+    }
+
+    writeTableCache(entries);
+}
+
+/**
+ * A 64-bit FNV-1a hash of everything one table's output depends on: this generator
+ * and its options, the table, every table it refers to or that refers to it, and the
+ * build of DataModeler itself, so a new version regenerates everything.
+ */
+string CodeGenerator::tableHash(const Table &table) {
+    string text = string{buildStamp()} + generatorInfo->toJSON().dump() + table.toJSON().dump();
+    const DataModel::Relationships &relationships = model.getRelationships();
+    for (const Table::Pointer &other: relationships.childTables(table)) {
+        if (other->getName() != table.getName()) {
+            text += other->toJSON().dump();
+        }
+    }
+    for (const Table::Pointer &other: relationships.parentTables(table)) {
+        if (other->getName() != table.getName() && relationships.referencesFrom(*other, table).empty()) {
+            text += other->toJSON().dump();
+        }
+    }
+
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c: text) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+
+    char buffer[17];
+    snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(hash));
+    return buffer;
+}
+
+/**
+ * Each generator keeps its own cache, as several may share an output directory.
+ */
+string CodeGenerator::tableCacheName() {
+    string fileName = ".DataModeler_" + generatorInfo->getName() + ".cache";
+    for (char &c: fileName) {
+        if (!isalnum(static_cast<unsigned char>(c)) && c != '.' && c != '_') {
+            c = '_';
+        }
+    }
+    return generatorInfo->getOutputBasePath() + "/" + fileName;
+}
+
+/**
+ * The cache is one line per table: the name, the hash, and the files it wrote,
+ * separated by tabs. A line we can't read just means that table is regenerated.
+ */
+std::unordered_map<string, CodeGenerator::TableCacheEntry> CodeGenerator::readTableCache() {
+    std::unordered_map<string, TableCacheEntry> cache;
+    std::ifstream ifs { tableCacheName() };
+    string line;
+
+    while (std::getline(ifs, line)) {
+        std::vector<string> fields;
+        size_t start = 0;
+        for (size_t tab = line.find('\t'); tab != string::npos; tab = line.find('\t', start)) {
+            fields.push_back(line.substr(start, tab - start));
+            start = tab + 1;
+        }
+        fields.push_back(line.substr(start));
+
+        if (fields.size() >= 2) {
+            TableCacheEntry &entry = cache[fields[0]];
+            entry.hash = fields[1];
+            entry.fileNames.assign(fields.begin() + 2, fields.end());
+        }
+    }
+
+    return cache;
+}
+
+void CodeGenerator::writeTableCache(const std::vector<TableCacheEntry> &entries) {
+    const Table::Vector &tables = model.getTables();
+    OutputFile ofs { tableCacheName() };
+
+    for (size_t index = 0; index < tables.size(); ++index) {
+        ofs << tables[index]->getName() << '\t' << entries[index].hash;
+        for (const string &fileName: entries[index].fileNames) {
+            ofs << '\t' << fileName;
+        }
+        ofs << endl;
+    }
+}
+
+/**
+ * With the nativeTime option, the C++ and DB generators both need base/TimeUtilities.h,
+ * which converts the std::chrono types to and from PostgreSQL's text format. Either may
+ * write it; the contents are the same.
+ */
+void CodeGenerator::generateTimeUtilities(const std::string &dirName) {
+    // The generators may be running at the same time, and may share a directory.
+    static std::mutex fileMutex;
+    std::lock_guard<std::mutex> lock { fileMutex };
+
+    OutputFile ofs{dirName + "/TimeUtilities.h"};
+
+    ofs << "#pragma once" << endl
+        << endl
+        << "#include <algorithm>" << endl
+        << "#include <charconv>" << endl
+        << "#include <chrono>" << endl
+        << "#include <cstdio>" << endl
+        << "#include <functional>" << endl
+        << "#include <optional>" << endl
+        << "#include <string>" << endl
+        << "#include <string_view>" << endl
+        << endl
+        << "/**" << endl
+        << " * Conversions between PostgreSQL's ISO text format and the std::chrono types we use" << endl
+        << " * for Date, Timestamp, and TimestampTZ columns. Nullable columns are std::optional:" << endl
+        << " * std::nullopt formats as an empty string, which the generated SQL writes as NULL," << endl
+        << " * and the ...OrNull parsers turn an empty string back into std::nullopt." << endl
+        << " */" << endl
+        << "namespace TimeUtilities_Detail {" << endl
+        << "\tinline bool readNumber(std::string_view &text, size_t digits, int &value) {" << endl
+        << "\t\tif (text.size() < digits) {" << endl
+        << "\t\t\treturn false;" << endl
+        << "\t\t}" << endl
+        << "\t\tauto result = std::from_chars(text.data(), text.data() + digits, value);" << endl
+        << "\t\tif (result.ptr != text.data() + digits) {" << endl
+        << "\t\t\treturn false;" << endl
+        << "\t\t}" << endl
+        << "\t\ttext.remove_prefix(digits);" << endl
+        << "\t\treturn true;" << endl
+        << "\t}" << endl
+        << endl
+        << "\tinline bool skip(std::string_view &text, char c) {" << endl
+        << "\t\tif (text.empty() || text[0] != c) {" << endl
+        << "\t\t\treturn false;" << endl
+        << "\t\t}" << endl
+        << "\t\ttext.remove_prefix(1);" << endl
+        << "\t\treturn true;" << endl
+        << "\t}" << endl
+        << endl
+        << "\tinline std::string formatDay(std::chrono::sys_days value) {" << endl
+        << "\t\tstd::chrono::year_month_day ymd{value};" << endl
+        << "\t\tchar buffer[16];" << endl
+        << "\t\tstd::snprintf(buffer, sizeof(buffer), \"%04d-%02u-%02u\"," << endl
+        << "\t\t\tstatic_cast<int>(ymd.year()), static_cast<unsigned>(ymd.month()), static_cast<unsigned>(ymd.day()));" << endl
+        << "\t\treturn buffer;" << endl
+        << "\t}" << endl
+        << "}" << endl
+        << endl
+        << "/** YYYY-MM-DD. */" << endl
+        << "inline std::chrono::sys_days parseDate(std::string_view text) {" << endl
+        << "\tusing namespace TimeUtilities_Detail;" << endl
+        << "\tint year = 0, month = 0, day = 0;" << endl
+        << endl
+        << "\tif (text == \"infinity\") {" << endl
+        << "\t\treturn std::chrono::sys_days::max();" << endl
+        << "\t}" << endl
+        << "\tif (text == \"-infinity\") {" << endl
+        << "\t\treturn std::chrono::sys_days::min();" << endl
+        << "\t}" << endl
+        << "\tif (!readNumber(text, 4, year) || !skip(text, '-') || !readNumber(text, 2, month) || !skip(text, '-') || !readNumber(text, 2, day)) {" << endl
+        << "\t\treturn std::chrono::sys_days{};" << endl
+        << "\t}" << endl
+        << "\treturn std::chrono::sys_days{ std::chrono::year{year} / month / day };" << endl
+        << "}" << endl
+        << endl
+        << "/** YYYY-MM-DD HH:MM:SS[.ffffff][+HH[:MM[:SS]]], with a space or T in the middle. */" << endl
+        << "inline std::chrono::sys_time<std::chrono::microseconds> parseTimestamp(std::string_view text) {" << endl
+        << "\tusing namespace std::chrono;" << endl
+        << "\tusing namespace TimeUtilities_Detail;" << endl
+        << "\tusing Result = sys_time<microseconds>;" << endl
+        << endl
+        << "\tif (text == \"infinity\") {" << endl
+        << "\t\treturn Result::max();" << endl
+        << "\t}" << endl
+        << "\tif (text == \"-infinity\") {" << endl
+        << "\t\treturn Result::min();" << endl
+        << "\t}" << endl
+        << "\tif (text.size() < 10) {" << endl
+        << "\t\treturn Result{};" << endl
+        << "\t}" << endl
+        << endl
+        << "\tsys_days day = parseDate(text.substr(0, 10));" << endl
+        << "\ttext.remove_prefix(10);" << endl
+        << endl
+        << "\tmicroseconds time {0};" << endl
+        << "\tif (skip(text, ' ') || skip(text, 'T')) {" << endl
+        << "\t\tint hour = 0, minute = 0, second = 0;" << endl
+        << "\t\tif (readNumber(text, 2, hour) && skip(text, ':') && readNumber(text, 2, minute) && skip(text, ':') && readNumber(text, 2, second)) {" << endl
+        << "\t\t\ttime = hours{hour} + minutes{minute} + seconds{second};" << endl
+        << "\t\t}" << endl
+        << "\t\tif (skip(text, '.')) {" << endl
+        << "\t\t\tsize_t digits = 0;" << endl
+        << "\t\t\twhile (digits < text.size() && text[digits] >= '0' && text[digits] <= '9') {" << endl
+        << "\t\t\t\t++digits;" << endl
+        << "\t\t\t}" << endl
+        << "\t\t\tint fraction = 0;" << endl
+        << "\t\t\tstd::from_chars(text.data(), text.data() + std::min<size_t>(digits, 6), fraction);" << endl
+        << "\t\t\tfor (size_t index = digits; index < 6; ++index) {" << endl
+        << "\t\t\t\tfraction *= 10;" << endl
+        << "\t\t\t}" << endl
+        << "\t\t\ttime += microseconds{fraction};" << endl
+        << "\t\t\ttext.remove_prefix(digits);" << endl
+        << "\t\t}" << endl
+        << "\t}" << endl
+        << endl
+        << "\t// timestamptz values carry the session's offset." << endl
+        << "\tif (!text.empty() && (text[0] == '+' || text[0] == '-')) {" << endl
+        << "\t\tint sign = text[0] == '-' ? -1 : 1;" << endl
+        << "\t\tint hour = 0, minute = 0, second = 0;" << endl
+        << "\t\ttext.remove_prefix(1);" << endl
+        << "\t\treadNumber(text, 2, hour);" << endl
+        << "\t\tif (skip(text, ':')) {" << endl
+        << "\t\t\treadNumber(text, 2, minute);" << endl
+        << "\t\t}" << endl
+        << "\t\tif (skip(text, ':')) {" << endl
+        << "\t\t\treadNumber(text, 2, second);" << endl
+        << "\t\t}" << endl
+        << "\t\ttime -= sign * (hours{hour} + minutes{minute} + seconds{second});" << endl
+        << "\t}" << endl
+        << endl
+        << "\treturn Result{day} + time;" << endl
+        << "}" << endl
+        << endl
+        << "inline std::chrono::sys_time<std::chrono::microseconds> parseTimestampTZ(std::string_view text) {" << endl
+        << "\treturn parseTimestamp(text);" << endl
+        << "}" << endl
+        << endl
+        << "inline std::optional<std::chrono::sys_days> parseDateOrNull(std::string_view text) {" << endl
+        << "\treturn text.empty() ? std::nullopt : std::optional{ parseDate(text) };" << endl
+        << "}" << endl
+        << endl
+        << "inline std::optional<std::chrono::sys_time<std::chrono::microseconds>> parseTimestampOrNull(std::string_view text) {" << endl
+        << "\treturn text.empty() ? std::nullopt : std::optional{ parseTimestamp(text) };" << endl
+        << "}" << endl
+        << endl
+        << "inline std::optional<std::chrono::sys_time<std::chrono::microseconds>> parseTimestampTZOrNull(std::string_view text) {" << endl
+        << "\treturn text.empty() ? std::nullopt : std::optional{ parseTimestampTZ(text) };" << endl
+        << "}" << endl
+        << endl
+        << "inline std::string formatDate(std::chrono::sys_days value) {" << endl
+        << "\tif (value == std::chrono::sys_days::max()) {" << endl
+        << "\t\treturn \"infinity\";" << endl
+        << "\t}" << endl
+        << "\tif (value == std::chrono::sys_days::min()) {" << endl
+        << "\t\treturn \"-infinity\";" << endl
+        << "\t}" << endl
+        << "\treturn TimeUtilities_Detail::formatDay(value);" << endl
+        << "}" << endl
+        << endl
+        << "inline std::string formatTimestamp(std::chrono::sys_time<std::chrono::microseconds> value) {" << endl
+        << "\tusing namespace std::chrono;" << endl
+        << "\tusing Value = sys_time<microseconds>;" << endl
+        << endl
+        << "\tif (value == Value::max()) {" << endl
+        << "\t\treturn \"infinity\";" << endl
+        << "\t}" << endl
+        << "\tif (value == Value::min()) {" << endl
+        << "\t\treturn \"-infinity\";" << endl
+        << "\t}" << endl
+        << endl
+        << "\tsys_days day = floor<days>(value);" << endl
+        << "\thh_mm_ss<microseconds> time{value - day};" << endl
+        << "\tchar buffer[32];" << endl
+        << "\tstd::snprintf(buffer, sizeof(buffer), \" %02d:%02d:%02d.%06lld\"," << endl
+        << "\t\tstatic_cast<int>(time.hours().count()), static_cast<int>(time.minutes().count())," << endl
+        << "\t\tstatic_cast<int>(time.seconds().count()), static_cast<long long>(time.subseconds().count()));" << endl
+        << "\treturn TimeUtilities_Detail::formatDay(day) + buffer;" << endl
+        << "}" << endl
+        << endl
+        << "/** Same as formatTimestamp() but marked as UTC, which is what our values hold. */" << endl
+        << "inline std::string formatTimestampTZ(std::chrono::sys_time<std::chrono::microseconds> value) {" << endl
+        << "\tusing Value = std::chrono::sys_time<std::chrono::microseconds>;" << endl
+        << "\tstd::string retVal = formatTimestamp(value);" << endl
+        << "\treturn (value == Value::max() || value == Value::min()) ? retVal : retVal + \"+00\";" << endl
+        << "}" << endl
+        << endl
+        << "/** The nullable columns' values. std::nullopt is NULL, which we write as an empty string. */" << endl
+        << "template <typename T>" << endl
+        << "inline std::string formatDate(const std::optional<T> &value) {" << endl
+        << "\treturn value ? formatDate(*value) : std::string{};" << endl
+        << "}" << endl
+        << endl
+        << "template <typename T>" << endl
+        << "inline std::string formatTimestamp(const std::optional<T> &value) {" << endl
+        << "\treturn value ? formatTimestamp(*value) : std::string{};" << endl
+        << "}" << endl
+        << endl
+        << "template <typename T>" << endl
+        << "inline std::string formatTimestampTZ(const std::optional<T> &value) {" << endl
+        << "\treturn value ? formatTimestampTZ(*value) : std::string{};" << endl
+        << "}" << endl
+        << endl
+        << "/** std::hash has no specializations for the chrono types, so indexes use this. */" << endl
+        << "struct ChronoHash {" << endl
+        << "\ttemplate <typename T>" << endl
+        << "\tsize_t operator()(const T &value) const {" << endl
+        << "\t\treturn std::hash<long long>{}(static_cast<long long>(value.time_since_epoch().count()));" << endl
+        << "\t}" << endl
+        << endl
+        << "\ttemplate <typename T>" << endl
+        << "\tsize_t operator()(const std::optional<T> &value) const {" << endl
+        << "\t\treturn value ? (*this)(*value) : 0;" << endl
+        << "\t}" << endl
+        << "};" << endl
+           ;
+}
+
+/**
+ * With the SQL generators' notifyTriggers option, each table's trigger sends its changes
+ * on this channel, and the DB generator's notifyListener listens on it.
+ */
+string CodeGenerator::notifyChannelFor(const Table &table) {
+    return table.getDbName() + "_changed";
+}
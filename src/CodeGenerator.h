@@ -1,7 +1,14 @@
 #pragma once
 
+#include <functional>
 #include <string>
+#include <unordered_map>
+#include <vector>
+
 #include "DataModel.h"
+#include "OutputFile.h"
+
+class ThreadPool;
 
 /**
  * This is the base class for all code generators.
@@ -15,9 +22,32 @@ public:
 
     std::string name;
 
+    /** If set, per-table work is spread across this pool. The model is read-only while we generate. */
+    ThreadPool * threadPool = nullptr;
+
+    /** If set, regenerate every table even if the cache says it hasn't changed. */
+    bool force = false;
+
+    static std::string notifyChannelFor(const DataModel::Table &);
+
 protected:
     DataModel &model;
     DataModel::Generator::Pointer generatorInfo;
 
+    void forEachTable(const std::function<void(const DataModel::Table::Pointer &)> &fn);
+    void generateTimeUtilities(const std::string &dirName);
+
+private:
+    /** What the cache knows of a table: the hash of its inputs, and the files it wrote. */
+    class TableCacheEntry {
+    public:
+        std::string hash;
+        std::vector<std::string> fileNames;
+    };
+
+    std::string tableHash(const DataModel::Table &);
+    std::string tableCacheName();
+    std::unordered_map<std::string, TableCacheEntry> readTableCache();
+    void writeTableCache(const std::vector<TableCacheEntry> &entries);
 };
 
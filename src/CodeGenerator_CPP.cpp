@@ -1,6 +1,8 @@
 #include <iostream>
 #include <fstream>
 #include <filesystem>
+#include <algorithm>
+#include <vector>
 
 #include <showlib/CommonUsing.h>
 #include <showlib/StringUtils.h>
@@ -13,6 +15,7 @@ using std::ostream;
 
 using Table = DataModel::Table;
 using Column = DataModel::Column;
+using Relationships = DataModel::Relationships;
 using DataType = DataModel::Column::DataType;
 
 CodeGenerator_CPP::CodeGenerator_CPP(DataModel &m, DataModel::Generator::Pointer genInfo)
@@ -32,15 +35,53 @@ CodeGenerator_CPP::generate() {
         exit(2);
     }
 
+    const std::unordered_map<std::string, std::string> & options = generatorInfo->getOptions();
+    for (auto const& [key, value] : options) {
+        if (key == "finderIndex") {
+            if (value != "hash" && value != "sorted") {
+                cerr << "Option finderIndex must be hash or sorted, not " << value << endl;
+                exit(2);
+            }
+            finderIndex = value;
+        }
+        else if (key == "valueTypes") {
+            wantValueTypes = value == "true";
+        }
+        else if (key == "columnSnapshots") {
+            wantColumnSnapshots = value == "true";
+        }
+        else if (key == "nativeTime") {
+            nativeTime = value == "true";
+        }
+        else if (key == "dirtyTracking") {
+            wantDirtyTracking = value == "true";
+        }
+    }
+
     generateIncludes();
+    if (!finderIndex.empty()) {
+        generateFinderIndex();
+    }
+    if (wantColumnSnapshots) {
+        generateColumnStorage();
+    }
+    if (nativeTime) {
+        generateTimeUtilities(cppStubDirName);
+    }
 
-    for (const Table::Pointer & table: model.getTables()) {
+    forEachTable([this](const Table::Pointer &table) {
         generateH(*table);
         generateCPP(*table);
+        if (wantValueTypes) {
+            generateValueH(*table);
+        }
+        if (wantColumnSnapshots) {
+            generateColumnsH(*table);
+        }
 
         generateConcreteH(*table);
         generateConcreteCPP(*table);
-    }
+    });
 
     generateUtilities();
 }
@@ -53,8 +94,8 @@ CodeGenerator_CPP::generateIncludes() {
     string hName = generatorInfo->getOutputClassPath() + "/" + model.getName() + ".h";
     string dbhName = generatorInfo->getOutputClassPath() + "/DB_" + model.getName() + ".h";
 
-    std::ofstream hOutput{hName};
-    std::ofstream dbOutput{dbhName};
+    OutputFile hOutput{hName};
+    OutputFile dbOutput{dbhName};
 
     for (const Table::Pointer &table: model.getTables()) {
         hOutput << "#include <" << cppIncludePath << table->getName() << ".h>" << endl;
@@ -70,7 +111,7 @@ CodeGenerator_CPP::generateH(Table &table) {
     string name = table.getName();
     string myClassName = name + "_Base";
     string hName = cppStubDirName + "/" + myClassName + ".h";
-    std::ofstream ofs{hName};
+    OutputFile ofs{hName};
 
     //--------------------------------------------------
     // Header portion.
@@ -80,14 +121,28 @@ CodeGenerator_CPP::generateH(Table &table) {
         << "#include <string>" << endl
         << "#include <vector>" << endl
         << "#include <memory>" << endl
-        << endl
            ;
 
+    if (wantDirtyTracking) {
+        ofs << "#include <bitset>" << endl;
+    }
+    ofs << endl;
+
     if (wantJSON) {
         ofs << "#include <showlib/JSONSerializable.h>" << endl;
         ofs << endl;
     }
 
+    if (nativeTime) {
+        ofs << "#include <" << cppIncludePath << "base/TimeUtilities.h>" << endl
+            << endl;
+    }
+
+    if (!finderIndex.empty()) {
+        ofs << "#include <" << cppIncludePath << "base/FinderIndex.h>" << endl
+            << endl;
+    }
+
     generateH_ForwardReferences(ofs, table);
 
     //--------------------------------------------------
@@ -110,7 +165,12 @@ CodeGenerator_CPP::generateH(Table &table) {
         << "    typedef std::shared_ptr<" << name << "> Pointer;" << endl
         << "    typedef std::weak_ptr<" << name << "> WPointer;" << endl
         << "    typedef ShowLib::JSONSerializableVector<" << name << "> Vector;" << endl
-        << endl;
+           ;
+
+    if (wantDirtyTracking) {
+        ofs << "    typedef std::bitset<" << table.getColumns().size() << "> DirtyColumns;" << endl;
+    }
+    ofs << endl;
 
     //--------------------------------------------------
     // Constructors and destructor
@@ -125,9 +185,10 @@ CodeGenerator_CPP::generateH(Table &table) {
     //--------------------------------------------------
 
     ofs << endl << "\t// Getters and setters." << endl;
+    size_t columnIndex = 0;
     for (const Column::Pointer &column: table.getColumns()) {
         string upperName = firstUpper(column->getName());
-        string cType = cTypeFor(column->getDataType());
+        string cType = cTypeFor(*column, nativeTime);
         bool isStr = isString(cType);
         string constness = isStr ? "const " : "";
         string refness = isStr ? " &" : "";
@@ -137,12 +198,32 @@ CodeGenerator_CPP::generateH(Table &table) {
             << "() const { return " << column->getName() << "; }" << endl;
 
         ofs << "    " << myClassName << " & set" << upperName
-            << " (" << constness << ns << cType << refness << " valueIn)"
-            << " { " << column->getName() << " = valueIn; return *this; }"
-            << endl;
+            << " (" << constness << ns << cType << refness << " valueIn)";
+        if (wantDirtyTracking) {
+            ofs << " { if (" << column->getName() << " != valueIn) { " << column->getName() << " = valueIn; dirtyColumns.set("
+                << columnIndex << "); } return *this; }" << endl;
+        }
+        else {
+            ofs << " { " << column->getName() << " = valueIn; return *this; }" << endl;
+        }
+        ++columnIndex;
     }
     generateH_FK_Access(ofs, table);
 
+    //--------------------------------------------------
+    // Dirty tracking. The DB layer uses this to update only what changed.
+    //--------------------------------------------------
+    if (wantDirtyTracking) {
+        ofs << endl
+            << "\t// Which columns have changed since we were read or written, by position in the table." << endl
+            << "    const DirtyColumns & getDirtyColumns() const { return dirtyColumns; }" << endl
+            << "    bool isDirty() const { return dirtyColumns.any(); }" << endl
+            << "    void markClean() { dirtyColumns.reset(); }" << endl
+            << "    void markAllDirty() { dirtyColumns.set(); }" << endl
+            << "    void setDirtyColumns(const DirtyColumns &value) { dirtyColumns = value; }" << endl
+               ;
+    }
+
     //--------------------------------------------------
     // JSON methods.
     //--------------------------------------------------
@@ -159,7 +240,7 @@ CodeGenerator_CPP::generateH(Table &table) {
     ofs << "private:" << endl;
 
     for (const Column::Pointer &column: table.getColumns()) {
-        string cType = cTypeFor(column->getDataType());
+        string cType = cTypeFor(*column, nativeTime);
         bool isStr = isString(cType);
         string ns = isStr ? "std::" : "";
 
@@ -175,6 +256,9 @@ CodeGenerator_CPP::generateH(Table &table) {
         }
         ofs << ";" << endl;
     }
+    if (wantDirtyTracking) {
+        ofs << "    DirtyColumns dirtyColumns;" << endl;
+    }
     generateH_FK_Storage(ofs, table);
 
     //--------------------------------------------------
@@ -191,7 +275,7 @@ CodeGenerator_CPP::generateH(Table &table) {
         }
 
         string colUpper = firstUpper(col->getName());
-        string dataType = cTypeFor(col->getDataType());
+        string dataType = cTypeFor(*col, nativeTime);
         if (dataType == "string") {
             dataType = "std::string";
         }
@@ -199,6 +283,10 @@ CodeGenerator_CPP::generateH(Table &table) {
         ofs << myClassName << "::Pointer find_By" << colUpper
             << "(" << myClassName << "::Vector & vec, const " << dataType << " & value);" << endl;
     }
+
+    if (!finderIndex.empty()) {
+        generateH_IndexedVector(ofs, table);
+    }
 }
 
 
@@ -217,12 +305,9 @@ CodeGenerator_CPP::generateH_ForwardReferences(std::ostream &ofs, DataModel::Tab
     }
 
     // Do any FKs to us. We'll assume we don't point back and forth.
-    for (const Table::Pointer & otherTable: model.getTables()) {
-        Column::Pointer ref = otherTable->ourMapTableReference(table);
-        if (ref != nullptr) {
-            ofs << "class " << otherTable->getName() << ";" << endl;
-            didRefs = true;
-        }
+    for (const Relationships::Reference &reference: model.getRelationships().primaryKeyReferences(table)) {
+        ofs << "class " << reference.first->getName() << ";" << endl;
+        didRefs = true;
     }
 }
 
@@ -260,8 +345,9 @@ void CodeGenerator_CPP::generateH_FK_Access(ostream &ofs, DataModel::Table &tabl
     // a vector and put getFoos and addFoo method.
     //----------------------------------------------------------------------
     printedPrompt = false;
-    for (const Table::Pointer & otherTable: model.getTables()) {
-        for (const Column::Pointer & col: otherTable->getAllReferencesToTable(table)) {
+    const Relationships &relationships = model.getRelationships();
+    for (const Table::Pointer & otherTable: relationships.childTables(table)) {
+        for (const Column::Pointer & col: relationships.referencesFrom(*otherTable, table)) {
             Column::Pointer ref = col->getReferences();
             if (!printedPrompt) {
                 ofs << "\n    // Relationships to us.\n";
@@ -279,6 +365,9 @@ void CodeGenerator_CPP::generateH_FK_Access(ostream &ofs, DataModel::Table &tabl
                 << "	void add"       << name << "(const std::shared_ptr<" << otherTable->getName() << ">);" << endl
                 << "	void remove"    << name << "(const std::shared_ptr<" << otherTable->getName() << ">);" << endl
                 << "	void removeAll" << name << "();" << endl
+                << "	void reserve"   << name << "s(size_t count) { " << nameL << "Vector.reserve(count); }" << endl
+                << "	/** Like add" << name << "() without the duplicate check. For bulk linking. */" << endl
+                << "	void append"    << name << "(const std::shared_ptr<" << otherTable->getName() << "> ptr) { " << nameL << "Vector.push_back(ptr); }" << endl
                    ;
         }
     }
@@ -333,7 +422,7 @@ CodeGenerator_CPP::generateCPP(Table &table) {
     string name = table.getName();
     string myClassName = name + "_Base";
     string cppName = cppStubDirName + "/" + myClassName + ".cpp";
-    std::ofstream ofs{cppName};
+    OutputFile ofs{cppName};
 
     ofs << "#include <iostream>" << endl
         << endl
@@ -382,12 +471,26 @@ CodeGenerator_CPP::generateCPP(Table &table) {
         << "void " << myClassName << "::fromJSON(const JSON &json) {" << endl
            ;
 
+    size_t columnIndex = 0;
     for (const Column::Pointer &column: table.getColumns()) {
-        if (column->getSerialize()) {
-            ofs << "    " << column->getName() << " = " << cTypeFor(column->getDataType()) << "Value("
+        string timeName = nativeTime ? nativeTimeNameFor(column->getDataType()) : "";
+
+        if (column->getSerialize() && !timeName.empty()) {
+            ofs << "    " << column->getName() << " = parse" << timeName << (column->getNullable() ? "OrNull" : "") << "(stringValue("
+                << "json, \"" << column->getName() << "\"));"
+                << endl ;
+        }
+        else if (column->getSerialize()) {
+            ofs << "    " << column->getName() << " = " << cTypeFor(column->getDataType(), nativeTime) << "Value("
                 << "json, \"" << column->getName() << "\");"
                 << endl ;
         }
+
+        // Whatever came in from JSON gets written by the next update.
+        if (column->getSerialize() && wantDirtyTracking) {
+            ofs << "    dirtyColumns.set(" << columnIndex << ");" << endl;
+        }
+        ++columnIndex;
     }
 
     ofs << "}" << endl << endl;
@@ -403,7 +506,12 @@ CodeGenerator_CPP::generateCPP(Table &table) {
            ;
 
     for (const Column::Pointer &column: table.getColumns()) {
-        if (column->getSerialize()) {
+        string timeName = nativeTime ? nativeTimeNameFor(column->getDataType()) : "";
+
+        if (column->getSerialize() && !timeName.empty()) {
+            ofs << "    json[\"" << column->getName() << "\"] = format" << timeName << "(" << column->getName() << ");\n";
+        }
+        else if (column->getSerialize()) {
             ofs << "    json[\"" << column->getName() << "\"] = " << column->getName() << ";\n";
         }
     }
@@ -421,24 +529,25 @@ CodeGenerator_CPP::generateCPP(Table &table) {
 
         string colUpper = firstUpper(col->getName());
         ofs << myClassName << "::Pointer find_By" << colUpper
-            << "(" << myClassName << "::Vector & vec, const " << cTypeFor(col->getDataType())
+            << "(" << myClassName << "::Vector & vec, const " << cTypeFor(*col, nativeTime)
                 << " & value) {" << endl
             << "    return vec.findIf([=](const " << name
                 << "::Pointer &ptr){ return ptr->get" << colUpper << "() == value; });" << endl
             << "}" << endl;
     }
 
+    if (!finderIndex.empty()) {
+        generateC_IndexedVector(ofs, table);
+    }
+
     //======================================================================
     // Here is where we generate added and remover methods against
     // things with foreign key relationships to us.
     //======================================================================
-    for (const Table::Pointer & otherTable: model.getTables()) {
-        Column::Pointer ref = otherTable->ourMapTableReference(table);
-        if (ref != nullptr) {
-            generateC_FK_Add(ofs, table, *otherTable, *ref);
-            generateC_FK_Remove(ofs, table, *otherTable, *ref);
-            generateC_FK_RemoveAll(ofs, table, *otherTable, *ref);
-        }
+    for (const auto & [otherTable, ref]: model.getRelationships().primaryKeyReferences(table)) {
+        generateC_FK_Add(ofs, table, *otherTable, *ref);
+        generateC_FK_Remove(ofs, table, *otherTable, *ref);
+        generateC_FK_RemoveAll(ofs, table, *otherTable, *ref);
     }
 }
 
@@ -464,12 +573,9 @@ CodeGenerator_CPP::generateC_CommonIncludes(std::ostream &ofs, DataModel::Table
     }
 
     // Do any FKs to us. We'll assume we don't point back and forth.
-    for (const Table::Pointer & otherTable: model.getTables()) {
-        Column::Pointer ref = otherTable->ourMapTableReference(table);
-        if (ref != nullptr) {
-            ofs << "#include <" << cppIncludePath << otherTable->getName() << ".h>" << endl;
-            didRefs = true;
-        }
+    for (const Relationships::Reference &reference: model.getRelationships().primaryKeyReferences(table)) {
+        ofs << "#include <" << cppIncludePath << reference.first->getName() << ".h>" << endl;
+        didRefs = true;
     }
 
     // An extra blank line.
@@ -510,8 +616,7 @@ CodeGenerator_CPP::generateC_FK_Add(
     ofs << endl
         << "void " << table.getName() << "_Base::"
         << "add" << name << "(const std::shared_ptr<" << refTable.getName() << "> obj) {" << endl
-        << "    int thisId = obj->get" << theirCol << "();" << endl
-        << "    ShowLib::addIfNot(" << vecName << ", obj, [=](" << refName << "::Pointer ptr){ return ptr->get" << theirCol << "() == thisId; });" << endl
+        << "    ShowLib::addIfNot(" << vecName << ", obj, [=](" << refName << "::Pointer ptr){ return ptr == obj; });" << endl
         << "}" << endl
            ;
 }
@@ -545,8 +650,7 @@ CodeGenerator_CPP::generateC_FK_Remove(
     ofs << endl
         << "void " << table.getName() << "_Base::"
         << "remove" << name << "(const std::shared_ptr<" << refTable.getName() << "> obj) {" << endl
-        << "    int thisId = obj->get" << theirCol << "();" << endl
-        << "    ShowLib::eraseIf(" << vecName << ", [=](" << refName << "::Pointer ptr){ return ptr->get" << theirCol << "() == thisId; });" << endl
+        << "    ShowLib::eraseIf(" << vecName << ", [=](" << refName << "::Pointer ptr){ return ptr == obj; });" << endl
         << "}" << endl
            ;
 }
@@ -592,7 +696,7 @@ void CodeGenerator_CPP::generateConcreteH(DataModel::Table &table)
     string hName = generatorInfo->getOutputBasePath() + "/" + name + ".h";
 
     if (!std::filesystem::exists(hName)) {
-        std::ofstream ofs{hName};
+        OutputFile ofs{hName};
 
         ofs << "#pragma once" << endl
             << endl
@@ -626,7 +730,7 @@ void CodeGenerator_CPP::generateConcreteCPP(DataModel::Table &table)
     string cppName = generatorInfo->getOutputBasePath() + "/" + name + ".cpp";
 
     if (!std::filesystem::exists(cppName)) {
-        std::ofstream ofs{cppName};
+        OutputFile ofs{cppName};
         ofs << "#include <" << cppIncludePath << name << ".h>" << endl
             << endl
             << name << "::~" << name << "() {" << endl
@@ -654,6 +758,26 @@ bool CodeGenerator_CPP::isString(const std::string &cType) {
     return cType == "string";
 }
 
+/**
+ * The columns Foo_IndexedVector indexes: the primary key and any with wantFinder.
+ */
+std::vector<Column::Pointer> CodeGenerator_CPP::indexedColumnsFor(DataModel::Table &table) {
+    std::vector<Column::Pointer> vec;
+
+    for (const Column::Pointer &col: table.getColumns()) {
+        if (col->getIsPrimaryKey() || col->getWantFinder()) {
+            vec.push_back(col);
+        }
+    }
+
+    return vec;
+}
+
+std::string CodeGenerator_CPP::keyTypeFor(DataModel::Column &col) {
+    string cType = cTypeFor(col, nativeTime);
+    return isString(cType) ? "std::string" : cType;
+}
+
 //----------------------------------------------------------------------
 // This is for generating the Utilities objects, defined in base/Utilities.h
 //----------------------------------------------------------------------
@@ -663,8 +787,8 @@ CodeGenerator_CPP::generateUtilities() {
     string hName = cppStubDirName + "/Utilities.h";
     string cppName = cppStubDirName + "/Utilities.cpp";
 
-    std::ofstream hOutput{hName};
-    std::ofstream cppOutput{cppName};
+    OutputFile hOutput{hName};
+    OutputFile cppOutput{cppName};
 
     //----------------------------------------------------------------------
     // The includes in both the .h and .cpp
@@ -675,9 +799,13 @@ CodeGenerator_CPP::generateUtilities() {
 
     for (const Table::Pointer &table: model.getTables()) {
         hOutput << "#include <" << cppIncludePath << table->getName() << ".h>" << endl;
+        if (wantValueTypes) {
+            hOutput << "#include <" << cppIncludePath << "base/" << table->getName() << "_Value.h>" << endl;
+        }
     }
 
     cppOutput << "#include <iostream>" << endl
+              << "#include <unordered_map>" << endl
               << "#include \"Utilities.h\"" << endl
               << endl;
 
@@ -700,21 +828,741 @@ CodeGenerator_CPP::generateUtilities() {
     // Now for each file, we find any FK references and create the helper.
     //----------------------------------------------------------------------
     for (const Table::Pointer &table: model.getTables()) {
+        std::vector<string> done;
+
         for (const Column::Pointer &column: table->getColumns()) {
             const Column::Pointer ref = column->getReferences();
 
             // If this is non-null, we have at least one relationship between
-            // these two tables.
+            // these two tables. We only do each pair once, as the generated
+            // methods handle every column from table to refTable.
             if (ref != nullptr) {
                 Table::Pointer refTable = ref->getOurTable().lock();
+                if (std::find(done.begin(), done.end(), refTable->getName()) != done.end()) {
+                    continue;
+                }
+                done.push_back(refTable->getName());
+
                 generateH_ResolveReferences(hOutput, table, refTable);
                 generateC_ResolveReferences(cppOutput, table, refTable);
-                break; // Only do once per pair. And this is going to break down if we point both directions.
+                if (wantValueTypes) {
+                    generateH_ValueResolveReferences(hOutput, table, refTable);
+                    generateC_ValueResolveReferences(cppOutput, table, refTable);
+                }
+            }
+        }
+    }
+}
+
+
+/**
+ * This writes base/FinderIndex.h, the two index templates Foo_IndexedVector uses.
+ * They're written into the output rather than kept in a library so that the
+ * generated code depends on nothing new.
+ *
+ * OpenHashIndex is a linear-probing hash table. Keys may repeat (finder columns
+ * needn't be unique), so a key can occupy more than one slot, and erase() needs
+ * the value as well. SortedIndex is a flat vector of pairs ordered by key. It
+ * also supports range lookups.
+ */
+void
+CodeGenerator_CPP::generateFinderIndex() {
+    string hName = cppStubDirName + "/FinderIndex.h";
+    OutputFile ofs{hName};
+
+    ofs << "#pragma once" << endl
+        << endl
+        << "#include <algorithm>" << endl
+        << "#include <cstdint>" << endl
+        << "#include <functional>" << endl
+        << "#include <utility>" << endl
+        << "#include <vector>" << endl
+        << endl
+
+        << "/**" << endl
+        << " * Open-addressing (linear probing) hash index from key to value." << endl
+        << " * Duplicate keys are allowed; find() returns any one of them." << endl
+        << " */" << endl
+        << "template <typename K, typename V, typename Hash = std::hash<K>>" << endl
+        << "class OpenHashIndex {" << endl
+        << "public:" << endl
+        << "\tvoid reserve(size_t wanted) {" << endl
+        << "\t\tsize_t capacity = 16;" << endl
+        << "\t\twhile (capacity * 3 < wanted * 4) {" << endl
+        << "\t\t\tcapacity *= 2;" << endl
+        << "\t\t}" << endl
+        << "\t\tif (capacity > slots.size()) {" << endl
+        << "\t\t\trehash(capacity);" << endl
+        << "\t\t}" << endl
+        << "\t}" << endl
+        << endl
+        << "\tvoid insert(const K &key, const V &value) {" << endl
+        << "\t\tif ((used + 1) * 4 > slots.size() * 3) {" << endl
+        << "\t\t\t// Double if we're really full. If it's mostly tombstones, rehashing in place clears them." << endl
+        << "\t\t\trehash(std::max<size_t>(16, (count + 1) * 2 > slots.size() ? slots.size() * 2 : slots.size()));" << endl
+        << "\t\t}" << endl
+        << "\t\tsize_t index = Hash{}(key) & (slots.size() - 1);" << endl
+        << "\t\twhile (slots[index].state == State::Full) {" << endl
+        << "\t\t\tindex = (index + 1) & (slots.size() - 1);" << endl
+        << "\t\t}" << endl
+        << "\t\tif (slots[index].state == State::Empty) {" << endl
+        << "\t\t\t++used;" << endl
+        << "\t\t}" << endl
+        << "\t\tslots[index] = Slot{State::Full, key, value};" << endl
+        << "\t\t++count;" << endl
+        << "\t}" << endl
+        << endl
+        << "\t/** Returns a default V (nullptr for pointers) if not found. */" << endl
+        << "\tV find(const K &key) const {" << endl
+        << "\t\tif (count == 0) {" << endl
+        << "\t\t\treturn V{};" << endl
+        << "\t\t}" << endl
+        << "\t\tfor (size_t index = Hash{}(key) & (slots.size() - 1);" << endl
+        << "\t\t     slots[index].state != State::Empty;" << endl
+        << "\t\t     index = (index + 1) & (slots.size() - 1))" << endl
+        << "\t\t{" << endl
+        << "\t\t\tif (slots[index].state == State::Full && slots[index].key == key) {" << endl
+        << "\t\t\t\treturn slots[index].value;" << endl
+        << "\t\t\t}" << endl
+        << "\t\t}" << endl
+        << "\t\treturn V{};" << endl
+        << "\t}" << endl
+        << endl
+        << "\tvoid erase(const K &key, const V &value) {" << endl
+        << "\t\tif (count == 0) {" << endl
+        << "\t\t\treturn;" << endl
+        << "\t\t}" << endl
+        << "\t\tfor (size_t index = Hash{}(key) & (slots.size() - 1);" << endl
+        << "\t\t     slots[index].state != State::Empty;" << endl
+        << "\t\t     index = (index + 1) & (slots.size() - 1))" << endl
+        << "\t\t{" << endl
+        << "\t\t\tSlot &slot = slots[index];" << endl
+        << "\t\t\tif (slot.state == State::Full && slot.key == key && slot.value == value) {" << endl
+        << "\t\t\t\tslot = Slot{State::Deleted, K{}, V{}};" << endl
+        << "\t\t\t\t--count;" << endl
+        << "\t\t\t\treturn;" << endl
+        << "\t\t\t}" << endl
+        << "\t\t}" << endl
+        << "\t}" << endl
+        << endl
+        << "\tvoid clear() { slots.clear(); count = 0; used = 0; }" << endl
+        << "\tsize_t size() const { return count; }" << endl
+        << endl
+        << "private:" << endl
+        << "\tenum class State: uint8_t { Empty, Full, Deleted };" << endl
+        << "\tstruct Slot {" << endl
+        << "\t\tState state = State::Empty;" << endl
+        << "\t\tK key {};" << endl
+        << "\t\tV value {};" << endl
+        << "\t};" << endl
+        << endl
+        << "\tvoid rehash(size_t capacity) {" << endl
+        << "\t\tstd::vector<Slot> old = std::move(slots);" << endl
+        << "\t\tslots = std::vector<Slot>(capacity);" << endl
+        << "\t\tcount = 0;" << endl
+        << "\t\tused = 0;" << endl
+        << "\t\tfor (Slot &slot: old) {" << endl
+        << "\t\t\tif (slot.state == State::Full) {" << endl
+        << "\t\t\t\tsize_t index = Hash{}(slot.key) & (capacity - 1);" << endl
+        << "\t\t\t\twhile (slots[index].state == State::Full) {" << endl
+        << "\t\t\t\t\tindex = (index + 1) & (capacity - 1);" << endl
+        << "\t\t\t\t}" << endl
+        << "\t\t\t\tslots[index] = std::move(slot);" << endl
+        << "\t\t\t\t++count;" << endl
+        << "\t\t\t\t++used;" << endl
+        << "\t\t\t}" << endl
+        << "\t\t}" << endl
+        << "\t}" << endl
+        << endl
+        << "\tstd::vector<Slot> slots;" << endl
+        << "\tsize_t count = 0;" << endl
+        << "\tsize_t used = 0;\t\t// Full plus Deleted, which is what limits probing." << endl
+        << "};" << endl
+        << endl
+
+        << "/**" << endl
+        << " * A flat vector of (key, value) kept in key order. Lookups are binary" << endl
+        << " * searches. Inserts in key order are appends; others shift the tail." << endl
+        << " */" << endl
+        << "template <typename K, typename V>" << endl
+        << "class SortedIndex {" << endl
+        << "public:" << endl
+        << "\tvoid reserve(size_t wanted) { entries.reserve(wanted); }" << endl
+        << endl
+        << "\tvoid insert(const K &key, const V &value) {" << endl
+        << "\t\tif (entries.empty() || !(key < entries.back().first)) {" << endl
+        << "\t\t\tentries.emplace_back(key, value);" << endl
+        << "\t\t\treturn;" << endl
+        << "\t\t}" << endl
+        << "\t\tauto it = std::upper_bound(entries.begin(), entries.end(), key, KeyLess{});" << endl
+        << "\t\tentries.emplace(it, key, value);" << endl
+        << "\t}" << endl
+        << endl
+        << "\t/** Returns a default V (nullptr for pointers) if not found. */" << endl
+        << "\tV find(const K &key) const {" << endl
+        << "\t\tauto it = std::lower_bound(entries.begin(), entries.end(), key, KeyLess{});" << endl
+        << "\t\treturn (it != entries.end() && it->first == key) ? it->second : V{};" << endl
+        << "\t}" << endl
+        << endl
+        << "\t/** All values with low <= key <= high, in key order. */" << endl
+        << "\tstd::vector<V> findRange(const K &low, const K &high) const {" << endl
+        << "\t\tstd::vector<V> retVal;" << endl
+        << "\t\tauto it = std::lower_bound(entries.begin(), entries.end(), low, KeyLess{});" << endl
+        << "\t\tauto end = std::upper_bound(it, entries.end(), high, KeyLess{});" << endl
+        << "\t\tfor (; it != end; ++it) {" << endl
+        << "\t\t\tretVal.push_back(it->second);" << endl
+        << "\t\t}" << endl
+        << "\t\treturn retVal;" << endl
+        << "\t}" << endl
+        << endl
+        << "\tvoid erase(const K &key, const V &value) {" << endl
+        << "\t\tauto it = std::lower_bound(entries.begin(), entries.end(), key, KeyLess{});" << endl
+        << "\t\tfor (; it != entries.end() && it->first == key; ++it) {" << endl
+        << "\t\t\tif (it->second == value) {" << endl
+        << "\t\t\t\tentries.erase(it);" << endl
+        << "\t\t\t\treturn;" << endl
+        << "\t\t\t}" << endl
+        << "\t\t}" << endl
+        << "\t}" << endl
+        << endl
+        << "\tvoid clear() { entries.clear(); }" << endl
+        << "\tsize_t size() const { return entries.size(); }" << endl
+        << endl
+        << "private:" << endl
+        << "\tusing Entry = std::pair<K, V>;" << endl
+        << "\tstruct KeyLess {" << endl
+        << "\t\tbool operator()(const Entry &entry, const K &key) const { return entry.first < key; }" << endl
+        << "\t\tbool operator()(const K &key, const Entry &entry) const { return key < entry.first; }" << endl
+        << "\t};" << endl
+        << endl
+        << "\tstd::vector<Entry> entries;" << endl
+        << "};" << endl
+           ;
+}
+
+/**
+ * With the finderIndex option, we write Foo_IndexedVector after the finders. It owns a
+ * Foo::Vector plus an index on the primary key and on each wantFinder column, and keeps
+ * them in step through add() and remove(). The objects' keys must not change while
+ * they're in the container.
+ */
+void
+CodeGenerator_CPP::generateH_IndexedVector(std::ostream &ofs, DataModel::Table &table) {
+    string myClassName = table.getName() + "_Base";
+    string className = table.getName() + "_IndexedVector";
+    string indexTemplate = finderIndex == "sorted" ? "SortedIndex" : "OpenHashIndex";
+    std::vector<Column::Pointer> columns = indexedColumnsFor(table);
+
+    ofs << endl
+        << "/**" << endl
+        << " * A " << table.getName() << "::Vector with " << finderIndex << " indexes for the finders." << endl
+        << " * Keys must not change while an object is in here." << endl
+        << " */" << endl
+        << "class " << className << " {" << endl
+        << "public:" << endl
+        << "\t" << className << "() = default;" << endl
+        << "\t" << className << "(const " << myClassName << "::Vector &);" << endl
+        << endl
+        << "\tconst " << myClassName << "::Vector & getVector() const { return vec; }" << endl
+        << "\tsize_t size() const { return vec.size(); }" << endl
+        << endl
+        << "\tvoid reserve(size_t);" << endl
+        << "\tvoid add(const " << myClassName << "::Pointer &);" << endl
+        << "\tvoid remove(const " << myClassName << "::Pointer &);" << endl
+        << "\tvoid clear();" << endl
+        << endl
+           ;
+
+    for (const Column::Pointer &col: columns) {
+        string colUpper = firstUpper(col->getName());
+        string keyType = keyTypeFor(*col);
+
+        ofs << "\t" << myClassName << "::Pointer find" << (col->getIsPrimaryKey() ? "By" : "_By") << colUpper
+            << "(const " << keyType << " & value) const;" << endl;
+
+        if (finderIndex == "sorted") {
+            ofs << "\tstd::vector<" << myClassName << "::Pointer> findRange_By" << colUpper
+                << "(const " << keyType << " & low, const " << keyType << " & high) const;" << endl;
+        }
+    }
+
+    ofs << endl
+        << "private:" << endl
+        << "\t" << myClassName << "::Vector vec;" << endl
+           ;
+
+    for (const Column::Pointer &col: columns) {
+        bool needsChronoHash = finderIndex == "hash" && nativeTime && !nativeTimeNameFor(col->getDataType()).empty();
+
+        ofs << "\t" << indexTemplate << "<" << keyTypeFor(*col) << ", " << myClassName << "::Pointer"
+            << (needsChronoHash ? ", ChronoHash" : "") << "> "
+            << col->getName() << "Index;" << endl;
+    }
+
+    ofs << "};" << endl;
+}
+
+/**
+ * The .cpp half of Foo_IndexedVector.
+ */
+void
+CodeGenerator_CPP::generateC_IndexedVector(std::ostream &ofs, DataModel::Table &table) {
+    string myClassName = table.getName() + "_Base";
+    string className = table.getName() + "_IndexedVector";
+    std::vector<Column::Pointer> columns = indexedColumnsFor(table);
+
+    ofs << endl
+        << className << "::" << className << "(const " << myClassName << "::Vector &from) {" << endl
+        << "    reserve(from.size());" << endl
+        << "    for (const " << myClassName << "::Pointer &ptr: from) {" << endl
+        << "        add(ptr);" << endl
+        << "    }" << endl
+        << "}" << endl
+        << endl
+        << "void " << className << "::reserve(size_t count) {" << endl
+        << "    vec.reserve(count);" << endl
+           ;
+    for (const Column::Pointer &col: columns) {
+        ofs << "    " << col->getName() << "Index.reserve(count);" << endl;
+    }
+    ofs << "}" << endl
+        << endl
+        << "void " << className << "::add(const " << myClassName << "::Pointer &ptr) {" << endl
+        << "    vec.push_back(ptr);" << endl
+           ;
+    for (const Column::Pointer &col: columns) {
+        ofs << "    " << col->getName() << "Index.insert(ptr->get" << firstUpper(col->getName()) << "(), ptr);" << endl;
+    }
+    ofs << "}" << endl
+        << endl
+        << "/**" << endl
+        << " * An object added twice is in here twice, and each index erase takes out one entry," << endl
+        << " * so we take out one copy from the vector too. ptr may be one of vec's own elements," << endl
+        << " * so we're done with it before we erase." << endl
+        << " */" << endl
+        << "void " << className << "::remove(const " << myClassName << "::Pointer &ptr) {" << endl
+        << "    auto it = std::find(vec.begin(), vec.end(), ptr);" << endl
+        << "    if (it == vec.end()) {" << endl
+        << "        return;" << endl
+        << "    }" << endl
+           ;
+    for (const Column::Pointer &col: columns) {
+        ofs << "    " << col->getName() << "Index.erase(ptr->get" << firstUpper(col->getName()) << "(), ptr);" << endl;
+    }
+    ofs << "    vec.erase(it);" << endl
+        << "}" << endl
+        << endl
+        << "void " << className << "::clear() {" << endl
+        << "    vec.clear();" << endl
+           ;
+    for (const Column::Pointer &col: columns) {
+        ofs << "    " << col->getName() << "Index.clear();" << endl;
+    }
+    ofs << "}" << endl;
+
+    for (const Column::Pointer &col: columns) {
+        string colUpper = firstUpper(col->getName());
+        string keyType = keyTypeFor(*col);
+
+        ofs << endl
+            << myClassName << "::Pointer " << className << "::find" << (col->getIsPrimaryKey() ? "By" : "_By") << colUpper
+            << "(const " << keyType << " & value) const {" << endl
+            << "    return " << col->getName() << "Index.find(value);" << endl
+            << "}" << endl
+               ;
+
+        if (finderIndex == "sorted") {
+            ofs << endl
+                << "std::vector<" << myClassName << "::Pointer> " << className << "::findRange_By" << colUpper
+                << "(const " << keyType << " & low, const " << keyType << " & high) const {" << endl
+                << "    return " << col->getName() << "Index.findRange(low, high);" << endl
+                << "}" << endl
+                   ;
+        }
+    }
+}
+
+/**
+ * With the valueTypes option, we also write base/Foo_Value.h: a plain struct with the
+ * same fields as Foo_Base but no virtual methods, no JSON, and no shared_ptr. These
+ * live contiguously in a Foo_Value::Vector (a std::vector). Relationships are raw
+ * pointers into the other table's Vector, set by resolveReferences(), so those
+ * vectors must not be resized afterwards.
+ */
+void
+CodeGenerator_CPP::generateValueH(DataModel::Table &table) {
+    string name = table.getName() + "_Value";
+    string hName = cppStubDirName + "/" + name + ".h";
+    OutputFile ofs{hName};
+
+    ofs << "#pragma once" << endl
+        << endl
+        << "#include <string>" << endl
+        << "#include <vector>" << endl
+        << endl
+           ;
+
+    //--------------------------------------------------
+    // Forward references for both directions.
+    //--------------------------------------------------
+    std::vector<string> forwards;
+    for (const Column::Pointer &column: table.getColumns()) {
+        const Column::Pointer ref = column->getReferences();
+        if (ref != nullptr) {
+            forwards.push_back(ref->getOurTable().lock()->getName() + "_Value");
+        }
+    }
+    for (const Table::Pointer & otherTable: model.getRelationships().childTables(table)) {
+        forwards.push_back(otherTable->getName() + "_Value");
+    }
+    std::sort(forwards.begin(), forwards.end());
+    forwards.erase(std::unique(forwards.begin(), forwards.end()), forwards.end());
+
+    if (nativeTime) {
+        ofs << "#include <" << cppIncludePath << "base/TimeUtilities.h>" << endl
+            << endl;
+    }
+
+    for (const string &forward: forwards) {
+        if (forward != name) {
+            ofs << "struct " << forward << ";" << endl;
+        }
+    }
+
+    ofs << endl
+        << "struct " << name << " {" << endl
+        << "    typedef std::vector<" << name << "> Vector;" << endl
+        << endl
+           ;
+
+    //--------------------------------------------------
+    // Fields.
+    //--------------------------------------------------
+    for (const Column::Pointer &column: table.getColumns()) {
+        string cType = cTypeFor(*column, nativeTime);
+
+        if (isString(cType)) {
+            ofs << "    std::string " << column->getName() << ";" << endl;
+        }
+        else if (isInt(cType) || isDouble(cType) || isBool(cType)) {
+            ofs << "    " << cType << " " << column->getName() << " = 0;" << endl;
+        }
+        else {
+            ofs << "    " << cType << " " << column->getName() << " {};" << endl;
+        }
+    }
+
+    //--------------------------------------------------
+    // Relationships: a pointer per FK we hold, and a
+    // vector of pointers for each FK that points to us.
+    //--------------------------------------------------
+    bool printedPrompt = false;
+    for (const Column::Pointer &col: table.getColumns()) {
+        Column::Pointer ref = col->getReferences();
+        if (ref != nullptr) {
+            if (!printedPrompt) {
+                ofs << endl << "    // Foreign relationships." << endl;
+                printedPrompt = true;
             }
+            Table::Pointer refTable = ref->getOurTable().lock();
+            string refPtrName = col->getRefPtrName();
+            if (refPtrName.empty()) {
+                refPtrName = firstLower(refTable->getName());
+            }
+            ofs << "    " << refTable->getName() << "_Value * " << refPtrName << " = nullptr;" << endl;
         }
     }
+
+    printedPrompt = false;
+    const Relationships &relationships = model.getRelationships();
+    for (const Table::Pointer & otherTable: relationships.childTables(table)) {
+        for (const Column::Pointer & col: relationships.referencesFrom(*otherTable, table)) {
+            if (!printedPrompt) {
+                ofs << endl << "    // Relationships to us." << endl;
+                printedPrompt = true;
+            }
+            string refName = col->getReversePtrName();
+            if (refName.empty()) {
+                refName = otherTable->getName();
+            }
+            ofs << "    std::vector<" << otherTable->getName() << "_Value *> " << firstLower(refName) << "s;" << endl;
+        }
+    }
+
+    ofs << "};" << endl;
 }
 
+/**
+ * With the columnSnapshots option, we write base/ColumnStorage.h. It holds the column
+ * types Foo_Columns is built from: ColumnVector<T>, a contiguous array plus a null
+ * bitmap, and DictionaryColumn, which stores a 32-bit code per row into a table of
+ * distinct strings. A scan that filters on a DictionaryColumn can look up the code once
+ * and then compare integers.
+ */
+void
+CodeGenerator_CPP::generateColumnStorage() {
+    string hName = cppStubDirName + "/ColumnStorage.h";
+    OutputFile ofs{hName};
+
+    ofs << "#pragma once" << endl
+        << endl
+        << "#include <cstdint>" << endl
+        << "#include <functional>" << endl
+        << "#include <string>" << endl
+        << "#include <string_view>" << endl
+        << "#include <unordered_map>" << endl
+        << "#include <vector>" << endl
+        << endl
+
+        << "/**" << endl
+        << " * One bit per row, set if the row is NULL." << endl
+        << " */" << endl
+        << "class NullBitmap {" << endl
+        << "public:" << endl
+        << "\tvoid reserve(size_t rows) { bits.reserve((rows + 63) / 64); }" << endl
+        << "\tvoid push_back(bool isNull) {" << endl
+        << "\t\tif (count % 64 == 0) {" << endl
+        << "\t\t\tbits.push_back(0);" << endl
+        << "\t\t}" << endl
+        << "\t\tif (isNull) {" << endl
+        << "\t\t\tbits.back() |= uint64_t{1} << (count % 64);" << endl
+        << "\t\t\t++nullCount;" << endl
+        << "\t\t}" << endl
+        << "\t\t++count;" << endl
+        << "\t}" << endl
+        << "\tbool isNull(size_t row) const { return (bits[row / 64] >> (row % 64)) & 1; }" << endl
+        << "\tsize_t getNullCount() const { return nullCount; }" << endl
+        << "\tconst std::vector<uint64_t> & getBits() const { return bits; }" << endl
+        << "\tvoid clear() { bits.clear(); count = 0; nullCount = 0; }" << endl
+        << endl
+        << "private:" << endl
+        << "\tstd::vector<uint64_t> bits;" << endl
+        << "\tsize_t count = 0;" << endl
+        << "\tsize_t nullCount = 0;" << endl
+        << "};" << endl
+        << endl
+
+        << "/**" << endl
+        << " * One column's values, contiguous. NULL rows hold T{}." << endl
+        << " */" << endl
+        << "template <typename T>" << endl
+        << "class ColumnVector {" << endl
+        << "public:" << endl
+        << "\tvoid reserve(size_t rows) { values.reserve(rows); nulls.reserve(rows); }" << endl
+        << "\tvoid push_back(const T &value) { values.push_back(value); nulls.push_back(false); }" << endl
+        << "\tvoid push_null() { values.push_back(T{}); nulls.push_back(true); }" << endl
+        << endl
+        << "\tsize_t size() const { return values.size(); }" << endl
+        << "\ttypename std::vector<T>::const_reference operator[](size_t row) const { return values[row]; }" << endl
+        << "\tbool isNull(size_t row) const { return nulls.isNull(row); }" << endl
+        << "\tconst std::vector<T> & getValues() const { return values; }" << endl
+        << "\tconst NullBitmap & getNulls() const { return nulls; }" << endl
+        << "\tvoid clear() { values.clear(); nulls.clear(); }" << endl
+        << endl
+        << "private:" << endl
+        << "\tstd::vector<T> values;" << endl
+        << "\tNullBitmap nulls;" << endl
+        << "};" << endl
+        << endl
+
+        << "/**" << endl
+        << " * A string column stored as a code per row into a list of distinct values." << endl
+        << " */" << endl
+        << "class DictionaryColumn {" << endl
+        << "public:" << endl
+        << "\tstatic constexpr uint32_t NOT_FOUND = UINT32_MAX;" << endl
+        << endl
+        << "\tvoid reserve(size_t rows) { codes.reserve(rows); nulls.reserve(rows); }" << endl
+        << "\tvoid push_back(std::string_view value) {" << endl
+        << "\t\tuint32_t code = codeFor(value);" << endl
+        << "\t\tif (code == NOT_FOUND) {" << endl
+        << "\t\t\tcode = static_cast<uint32_t>(dictionary.size());" << endl
+        << "\t\t\tdictionary.emplace_back(value);" << endl
+        << "\t\t\tlookup.emplace(dictionary.back(), code);" << endl
+        << "\t\t}" << endl
+        << "\t\tcodes.push_back(code);" << endl
+        << "\t\tnulls.push_back(false);" << endl
+        << "\t}" << endl
+        << "\tvoid push_null() { codes.push_back(NOT_FOUND); nulls.push_back(true); }" << endl
+        << endl
+        << "\tsize_t size() const { return codes.size(); }" << endl
+        << "\tconst std::string & operator[](size_t row) const {" << endl
+        << "\t\tstatic const std::string empty;" << endl
+        << "\t\treturn codes[row] == NOT_FOUND ? empty : dictionary[codes[row]];" << endl
+        << "\t}" << endl
+        << "\tbool isNull(size_t row) const { return nulls.isNull(row); }" << endl
+        << endl
+        << "\t/** The code for this value, or NOT_FOUND if no row has it. */" << endl
+        << "\tuint32_t codeFor(std::string_view value) const {" << endl
+        << "\t\tauto it = lookup.find(value);" << endl
+        << "\t\treturn it == lookup.end() ? NOT_FOUND : it->second;" << endl
+        << "\t}" << endl
+        << "\tuint32_t codeAt(size_t row) const { return codes[row]; }" << endl
+        << "\tconst std::vector<uint32_t> & getCodes() const { return codes; }" << endl
+        << "\tconst std::vector<std::string> & getDictionary() const { return dictionary; }" << endl
+        << "\tconst NullBitmap & getNulls() const { return nulls; }" << endl
+        << "\tvoid clear() { codes.clear(); dictionary.clear(); lookup.clear(); nulls.clear(); }" << endl
+        << endl
+        << "private:" << endl
+        << "\t// Lets us look up a string_view without building a std::string." << endl
+        << "\tstruct Hash {" << endl
+        << "\t\tusing is_transparent = void;" << endl
+        << "\t\tsize_t operator()(std::string_view value) const { return std::hash<std::string_view>{}(value); }" << endl
+        << "\t};" << endl
+        << endl
+        << "\tstd::vector<uint32_t> codes;" << endl
+        << "\tstd::vector<std::string> dictionary;" << endl
+        << "\tstd::unordered_map<std::string, uint32_t, Hash, std::equal_to<>> lookup;" << endl
+        << "\tNullBitmap nulls;" << endl
+        << "};" << endl
+           ;
+}
+
+/**
+ * Writes base/Foo_Columns.h, a snapshot of a table with one public member per column.
+ * Text columns are dictionary-encoded; everything else is a ColumnVector of the cType.
+ */
+void
+CodeGenerator_CPP::generateColumnsH(DataModel::Table &table) {
+    string name = table.getName() + "_Columns";
+    string hName = cppStubDirName + "/" + name + ".h";
+    OutputFile ofs{hName};
+
+    ofs << "#pragma once" << endl
+        << endl
+        << "#include <" << cppIncludePath << "base/ColumnStorage.h>" << endl
+           ;
+
+    if (nativeTime) {
+        ofs << "#include <" << cppIncludePath << "base/TimeUtilities.h>" << endl;
+    }
+
+    ofs << endl
+        << "/**" << endl
+        << " * " << table.getName() << ", stored one array per column." << endl
+        << " */" << endl
+        << "class " << name << " {" << endl
+        << "public:" << endl
+        << "    size_t size() const { return " << table.getColumns().at(0)->getName() << ".size(); }" << endl
+        << endl
+        << "    void reserve(size_t rows) {" << endl
+           ;
+
+    for (const Column::Pointer &column: table.getColumns()) {
+        ofs << "        " << column->getName() << ".reserve(rows);" << endl;
+    }
+
+    ofs << "    }" << endl
+        << endl
+        << "    void clear() {" << endl
+           ;
+
+    for (const Column::Pointer &column: table.getColumns()) {
+        ofs << "        " << column->getName() << ".clear();" << endl;
+    }
+
+    ofs << "    }" << endl
+        << endl
+           ;
+
+    for (const Column::Pointer &column: table.getColumns()) {
+        if (dataTypeWantsDictionary(column->getDataType())) {
+            ofs << "    DictionaryColumn " << column->getName() << ";" << endl;
+        }
+        else {
+            // ColumnVector has its own null bitmap, so time columns hold the plain chrono type.
+            string cType = cTypeFor(column->getDataType(), nativeTime);
+            ofs << "    ColumnVector<" << (isString(cType) ? "std::string" : cType) << "> " << column->getName() << ";" << endl;
+        }
+    }
+
+    ofs << "};" << endl;
+}
+
+/**
+ * The Foo_Value versions of resolveReferences(). Same hash join, on raw pointers.
+ */
+void CodeGenerator_CPP::generateH_ValueResolveReferences(
+        std::ostream &stream,
+        DataModel::Table::Pointer from,
+        DataModel::Table::Pointer to)
+{
+    string fromName = from->getName() + "_Value";
+    string toName = to->getName() + "_Value";
+
+    stream << "void resolveReferences(" << fromName << "::Vector &, " << toName << "::Vector &);\n";
+    if (from->getName() != to->getName()) {
+        stream << "void resolveReferences(" << toName << "::Vector &vecA, " << fromName << "::Vector &vecB);\n";
+    }
+    stream << "\n";
+}
+
+void CodeGenerator_CPP::generateC_ValueResolveReferences(
+        std::ostream &stream,
+        DataModel::Table::Pointer from,
+        DataModel::Table::Pointer to)
+{
+    string fromName = from->getName() + "_Value";
+    string toName = to->getName() + "_Value";
+
+    stream << "void resolveReferences("
+           << fromName << "::Vector &vecA, " << toName << "::Vector &vecB) {\n"
+           ;
+
+    for (const Column::Pointer &column: model.getRelationships().referencesFrom(*from, *to)) {
+        const Column::Pointer ref = column->getReferences();
+        string refPtrName = column->getRefPtrName();
+        string reverseName = column->getReversePtrName();
+
+        if (refPtrName.empty()) {
+            refPtrName = firstLower(to->getName());
+        }
+        if (reverseName.empty()) {
+            reverseName = from->getName();
+        }
+        string vecName = firstLower(reverseName) + "s";
+
+        string keyType = keyTypeFor(*ref);
+
+        stream << "    {\n"
+               << "        std::unordered_map<" << keyType << ", " << toName << " *> index;\n"
+               << "        index.reserve(vecB.size());\n"
+               << "        for (" << toName << " &inner: vecB) {\n"
+               << "            index.emplace(inner." << ref->getName() << ", &inner);\n"
+               << "        }\n"
+               << "\n"
+               << "        std::unordered_map<" << keyType << ", size_t> fanout;\n"
+               << "        for (const " << fromName << " &outer: vecA) {\n"
+               << "            ++fanout[outer." << column->getName() << "];\n"
+               << "        }\n"
+               << "        for (const auto & [key, count]: fanout) {\n"
+               << "            auto it = index.find(key);\n"
+               << "            if (it != index.end()) {\n"
+               << "                it->second->" << vecName << ".reserve(it->second->" << vecName << ".size() + count);\n"
+               << "            }\n"
+               << "        }\n"
+               << "\n"
+               << "        for (" << fromName << " &outer: vecA) {\n"
+               << "            auto it = index.find(outer." << column->getName() << ");\n"
+               << "            if (it != index.end() && outer." << refPtrName << " != it->second) {\n"
+               << "                outer." << refPtrName << " = it->second;\n"
+               << "                it->second->" << vecName << ".push_back(&outer);\n"
+               << "            }\n"
+               << "        }\n"
+               << "    }\n"
+                 ;
+    }
+
+    stream << "}\n\n";
+
+    if (from->getName() != to->getName()) {
+        stream << "/** This is a flip of the other direction. */\n"
+               << "void resolveReferences("
+               << toName << "::Vector &vecA, " << fromName << "::Vector &vecB) {\n"
+               << "	resolveReferences(vecB, vecA);\n"
+               << "}\n\n";
+    }
+}
 
 /**
  * See the lengthy comments for generateC_ResolveReferences(). This is the .h version.
@@ -725,12 +1573,25 @@ void CodeGenerator_CPP::generateH_ResolveReferences(
         DataModel::Table::Pointer to)
 {
     stream
-            << "void resolveReferences(" << from->getName() << "::Vector &, " << to->getName() << "::Vector &);\n"
-            << "void resolveReferences(" << to->getName() << "::Vector &vecA, " << from->getName() << "::Vector &vecB);\n"
+            << "void resolveReferences(" << from->getName() << "::Vector &, " << to->getName() << "::Vector &);\n";
+
+    if (from->getName() != to->getName()) {
+        stream << "void resolveReferences(" << to->getName() << "::Vector &vecA, " << from->getName() << "::Vector &vecB);\n";
+    }
 
+    stream
             << "// This version takes a pointed-to table row and finds all references to it.\n"
             << "void resolveReferences(" << to->getName() << "::Pointer &, " << from->getName() << "::Vector &);\n"
-            << "\n" ;
+            ;
+
+    for (const Column::Pointer &column: model.getRelationships().referencesFrom(*from, *to)) {
+        stream << "// Both vectors must already be sorted: vecA by " << column->getName()
+               << ", vecB by " << column->getReferences()->getName() << ".\n"
+               << "void resolveReferencesSorted_By" << ShowLib::firstUpper(column->getName())
+               << "(" << from->getName() << "::Vector &vecA, " << to->getName() << "::Vector &vecB);\n";
+    }
+
+    stream << "\n" ;
 }
 
 /**
@@ -750,6 +1611,15 @@ void CodeGenerator_CPP::generateH_ResolveReferences(
  *
  * These two methods are equivalent, and we can write the second one by calling
  * the first one with the arguments reversed.
+ *
+ * This is a hash join: we index vecB on the referenced column once and probe it
+ * for each row of vecA. Before linking, we count how many children each parent
+ * gets so each parent's vector is allocated once. If the child already points to
+ * the parent, it was linked by an earlier call, so we don't add it again.
+ *
+ * We also write a merge-join version per column for callers whose vectors are
+ * already sorted on the key (such as from an ORDER BY), plus the single-parent
+ * version.
  */
 void CodeGenerator_CPP::generateC_ResolveReferences(
         std::ostream &stream,
@@ -758,11 +1628,9 @@ void CodeGenerator_CPP::generateC_ResolveReferences(
 {
     stream << "void resolveReferences("
            << from->getName() << "::Vector &vecA, " << to->getName() << "::Vector &vecB) {\n"
-           << "    for (const " << from->getName() << "::Pointer &outer: vecA) {" << endl
-           << "        for (const " << to->getName() << "::Pointer &inner: vecB) {" << endl
            ;
 
-    for (const Column::Pointer &column: from->getAllReferencesToTable(*to)) {
+    for (const Column::Pointer &column: model.getRelationships().referencesFrom(*from, *to)) {
         const Column::Pointer ref = column->getReferences();
         string refName = ShowLib::firstUpper(column->getRefPtrName());
         string outerAddName = refName;
@@ -777,54 +1645,128 @@ void CodeGenerator_CPP::generateC_ResolveReferences(
             reverseName = ShowLib::firstUpper(from->getName());
         }
 
-        string refNameL = ShowLib::firstLower(refName);
+        string keyType = keyTypeFor(*ref);
+        string outerGetter = string{"get"} + ShowLib::firstUpper(column->getName()) + "()";
+        string innerGetter = string{"get"} + ShowLib::firstUpper(ref->getName()) + "()";
 
         // At this point, this column in the from table points to the to table.
         // For instance, forumThread->createdById -> member->memberId.
-        // So we set up a compare for the current record combination.
-        stream << "            if (outer->get" << ShowLib::firstUpper(column->getName()) << "() == "
-               <<"inner->get" << ShowLib::firstUpper(ref->getName()) << "() ) {\n"
-              << "                outer->set" << outerAddName << "(inner);\n"
-              << "                inner->add" << ShowLib::firstUpper(reverseName) << "(outer);\n"
-              << "            }\n"
+        stream << "    {\n"
+               << "        std::unordered_map<" << keyType << ", " << to->getName() << "::Pointer> index;\n"
+               << "        index.reserve(vecB.size());\n"
+               << "        for (const " << to->getName() << "::Pointer &inner: vecB) {\n"
+               << "            index.emplace(inner->" << innerGetter << ", inner);\n"
+               << "        }\n"
+               << "\n"
+               << "        std::unordered_map<" << keyType << ", size_t> fanout;\n"
+               << "        for (const " << from->getName() << "::Pointer &outer: vecA) {\n"
+               << "            ++fanout[outer->" << outerGetter << "];\n"
+               << "        }\n"
+               << "        for (const auto & [key, count]: fanout) {\n"
+               << "            auto it = index.find(key);\n"
+               << "            if (it != index.end()) {\n"
+               << "                it->second->reserve" << reverseName << "s(it->second->get" << reverseName << "s().size() + count);\n"
+               << "            }\n"
+               << "        }\n"
+               << "\n"
+               << "        for (const " << from->getName() << "::Pointer &outer: vecA) {\n"
+               << "            auto it = index.find(outer->" << outerGetter << ");\n"
+               << "            if (it != index.end() && outer->get" << outerAddName << "() != it->second) {\n"
+               << "                outer->set" << outerAddName << "(it->second);\n"
+               << "                it->second->append" << reverseName << "(outer);\n"
+               << "            }\n"
+               << "        }\n"
+               << "    }\n"
                  ;
-
     }
 
-    stream << "        }\n"
-           << "    }\n"
-           << "}\n\n"
+    stream << "}\n\n"
           ;
 
-    stream << "/** This is a flip of the other direction. */\n"
-           << "void resolveReferences("
-           << to->getName() << "::Vector &vecA, " << from->getName() << "::Vector &vecB) {\n"
-           << "	resolveReferences(vecB, vecA);\n"
-           << "}\n\n";
-
-/*
-
-           << "			if (outer->" << fromGetter << "() == inner->" << toGetter << "()) {" << endl
-           << "				outer->" << toSetter << "(inner); // Hmm." << endl
-           << "				inner->" << toAdder << "(outer);" << endl
-           << "			}" << endl
-           << "		}" << endl
-           << "	}" << endl
-           << "}" << endl << endl
-               ;
+    if (from->getName() != to->getName()) {
+        stream << "/** This is a flip of the other direction. */\n"
+               << "void resolveReferences("
+               << to->getName() << "::Vector &vecA, " << from->getName() << "::Vector &vecB) {\n"
+               << "	resolveReferences(vecB, vecA);\n"
+               << "}\n\n";
+    }
 
+    //----------------------------------------------------------------------
+    // One parent, any number of children. A straight scan.
+    //----------------------------------------------------------------------
     stream << "void resolveReferences("
-           << refTable->getName() << "::Pointer &parent, "
-           << table->getName() << "::Vector &vec) {" << endl
-           << "	for (const " << table->getName() << "::Pointer &child: vec) {" << endl
-           << "		if (child->" << fromGetter << "() == parent->" << toGetter << "()) {" << endl
-           << "			child->" << fromSetter << "(parent);" << endl
-           << "			parent->" << toAdder << "(child);" << endl
-           << "		}" << endl
-           << "	}" << endl
-               ;
+           << to->getName() << "::Pointer &parent, " << from->getName() << "::Vector &vec) {\n"
+           << "    for (const " << from->getName() << "::Pointer &child: vec) {\n"
+           ;
 
-    stream << "}" << endl << endl;
-*/
+    for (const Column::Pointer &column: model.getRelationships().referencesFrom(*from, *to)) {
+        const Column::Pointer ref = column->getReferences();
+        string outerAddName = ShowLib::firstUpper(column->getRefPtrName());
+        string reverseName = ShowLib::firstUpper(column->getReversePtrName());
+
+        if (outerAddName.empty()) {
+            outerAddName = ShowLib::firstUpper(to->getName());
+        }
+        if (reverseName.empty()) {
+            reverseName = ShowLib::firstUpper(from->getName());
+        }
+
+        stream << "        if (child->get" << ShowLib::firstUpper(column->getName()) << "() == parent->get" << ShowLib::firstUpper(ref->getName()) << "()"
+               << " && child->get" << outerAddName << "() != parent) {\n"
+               << "            child->set" << outerAddName << "(parent);\n"
+               << "            parent->append" << reverseName << "(child);\n"
+               << "        }\n"
+                  ;
+    }
 
+    stream << "    }\n"
+           << "}\n\n"
+              ;
+
+    //----------------------------------------------------------------------
+    // Merge joins. Each run of equal keys in vecA is matched against vecB
+    // as we walk forward through both.
+    //----------------------------------------------------------------------
+    for (const Column::Pointer &column: model.getRelationships().referencesFrom(*from, *to)) {
+        const Column::Pointer ref = column->getReferences();
+        string outerAddName = ShowLib::firstUpper(column->getRefPtrName());
+        string reverseName = ShowLib::firstUpper(column->getReversePtrName());
+
+        if (outerAddName.empty()) {
+            outerAddName = ShowLib::firstUpper(to->getName());
+        }
+        if (reverseName.empty()) {
+            reverseName = ShowLib::firstUpper(from->getName());
+        }
+
+        string outerGetter = string{"get"} + ShowLib::firstUpper(column->getName()) + "()";
+        string innerGetter = string{"get"} + ShowLib::firstUpper(ref->getName()) + "()";
+
+        stream << "void resolveReferencesSorted_By" << ShowLib::firstUpper(column->getName())
+               << "(" << from->getName() << "::Vector &vecA, " << to->getName() << "::Vector &vecB) {\n"
+               << "    size_t b = 0;\n"
+               << "    for (size_t a = 0; a < vecA.size(); ) {\n"
+               << "        auto key = vecA[a]->" << outerGetter << ";\n"
+               << "        size_t end = a + 1;\n"
+               << "        while (end < vecA.size() && vecA[end]->" << outerGetter << " == key) {\n"
+               << "            ++end;\n"
+               << "        }\n"
+               << "        while (b < vecB.size() && vecB[b]->" << innerGetter << " < key) {\n"
+               << "            ++b;\n"
+               << "        }\n"
+               << "        if (b < vecB.size() && vecB[b]->" << innerGetter << " == key) {\n"
+               << "            const " << to->getName() << "::Pointer &inner = vecB[b];\n"
+               << "            inner->reserve" << reverseName << "s(inner->get" << reverseName << "s().size() + (end - a));\n"
+               << "            for (; a < end; ++a) {\n"
+               << "                if (vecA[a]->get" << outerAddName << "() != inner) {\n"
+               << "                    vecA[a]->set" << outerAddName << "(inner);\n"
+               << "                    inner->append" << reverseName << "(vecA[a]);\n"
+               << "                }\n"
+               << "            }\n"
+               << "        }\n"
+               << "        a = end;\n"
+               << "    }\n"
+               << "}\n\n"
+                  ;
+    }
 }
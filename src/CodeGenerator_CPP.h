@@ -11,6 +11,21 @@ public:
 
     bool wantJSON = true;
 
+    /** If "hash" or "sorted", we also write Foo_IndexedVector with that kind of index. */
+    std::string finderIndex;
+
+    /** If set, we also write a plain Foo_Value struct for each table. */
+    bool wantValueTypes = false;
+
+    /** If set, we also write a column-oriented Foo_Columns class for each table. */
+    bool wantColumnSnapshots = false;
+
+    /** If set, Date and Timestamp columns use std::chrono types instead of strings. */
+    bool nativeTime = false;
+
+    /** If set, setters record which columns changed so updates can skip the rest. */
+    bool wantDirtyTracking = false;
+
 private:
     void generateIncludes();
 
@@ -18,6 +33,14 @@ private:
     void generateH(DataModel::Table &);
     void generateCPP(DataModel::Table &);
     void generateUtilities();
+    void generateFinderIndex();
+    void generateH_IndexedVector(std::ostream &, DataModel::Table &);
+    void generateC_IndexedVector(std::ostream &, DataModel::Table &);
+    void generateValueH(DataModel::Table &);
+    void generateColumnStorage();
+    void generateColumnsH(DataModel::Table &);
+    void generateH_ValueResolveReferences(std::ostream &, DataModel::Table::Pointer from, DataModel::Table::Pointer to);
+    void generateC_ValueResolveReferences(std::ostream &, DataModel::Table::Pointer from, DataModel::Table::Pointer to);
     void generateH_ResolveReferences(std::ostream &, DataModel::Table::Pointer from, DataModel::Table::Pointer to);
     void generateC_ResolveReferences(std::ostream &, DataModel::Table::Pointer from, DataModel::Table::Pointer to);
 
@@ -38,6 +61,8 @@ private:
     bool isDouble(const std::string &);
     bool isBool(const std::string &);
     bool isString(const std::string &);
+    std::vector<DataModel::Column::Pointer> indexedColumnsFor(DataModel::Table &);
+    std::string keyTypeFor(DataModel::Column &);
 
     std::string cppStubDirName;
     std::string cppIncludePath;
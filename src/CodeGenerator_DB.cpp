@@ -4,8 +4,10 @@
 // be empty, but this is where you could put additional hand-written
 // methods.
 //
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 
 #include <showlib/StringUtils.h>
 
@@ -28,6 +30,8 @@ using DataType = DataModel::Column::DataType;
 CodeGenerator_DB::CodeGenerator_DB(DataModel &m, DataModel::Generator::Pointer genInfo)
     : CodeGenerator("CodeGenerator_DB", m, genInfo)
 {
+    cppStubDirName = genInfo->getOutputBasePath() + "/base";
+    cppIncludePath = genInfo->getOutputClassPath();
 }
 
 /**
@@ -35,12 +39,75 @@ CodeGenerator_DB::CodeGenerator_DB(DataModel &m, DataModel::Generator::Pointer g
  */
 void
 CodeGenerator_DB::generate() {
-    for (const Table::Pointer & table: model.getTables()) {
+    const std::unordered_map<std::string, std::string> & options = generatorInfo->getOptions();
+    for (auto const& [key, value] : options) {
+        if (key == "preparedStatements") {
+            usePreparedStatements = value == "true";
+        }
+        else if (key == "fastParse") {
+            useFastParse = value == "true";
+        }
+        else if (key == "nativeTime") {
+            nativeTime = value == "true";
+        }
+        else if (key == "valueTypes") {
+            wantValueTypes = value == "true";
+        }
+        else if (key == "columnSnapshots") {
+            wantColumnSnapshots = value == "true";
+        }
+        else if (key == "insertChunkSize") {
+            insertChunkSize = std::max(1, std::stoi(value));
+        }
+        else if (key == "updateChunkSize") {
+            updateChunkSize = std::max(1, std::stoi(value));
+        }
+        else if (key == "connectionPool") {
+            wantConnectionPool = value == "true";
+        }
+        else if (key == "poolSize") {
+            poolSize = std::max(1, std::stoi(value));
+        }
+        else if (key == "dirtyTracking") {
+            dirtyTracking = value == "true";
+        }
+        else if (key == "cache") {
+            wantCache = value == "true";
+        }
+        else if (key == "cacheCapacity") {
+            cacheCapacity = std::max(1, std::stoi(value));
+        }
+        else if (key == "cacheShards") {
+            cacheShards = std::max(1, std::stoi(value));
+        }
+        else if (key == "notifyListener") {
+            wantNotifyListener = value == "true";
+        }
+    }
+
+    generateUtilities();
+    if (wantConnectionPool) {
+        generateConnectionPool();
+    }
+    if (wantCache) {
+        generateCache();
+    }
+    if (wantNotifyListener) {
+        generateNotifyListener();
+    }
+    if (nativeTime) {
+        generateTimeUtilities(cppStubDirName);
+    }
+
+    forEachTable([this](const Table::Pointer &table) {
         generateH(*table);
         generateCPP(*table);
+        if (wantCache) {
+            generateCached(*table);
+        }
         generateConcreteH(*table);
         generateConcreteCPP(*table);
-    }
+    });
 }
 
 //======================================================================
@@ -48,502 +115,2951 @@ CodeGenerator_DB::generate() {
 //======================================================================
 
 /**
- * Generate the .h file.
+ * This writes base/DB_Utilities.h, which holds small helpers shared by all
+ * of the generated DB_Foo_Base classes.
  */
 void
-CodeGenerator_DB::generateH(Table &table) {
-    string baseClassName = table.getName();
-    string myClassName = string{"DB_"} + baseClassName + "_Base";
-    string hName = cppStubDirName + "/" + myClassName + ".h";
-    std::ofstream ofs{hName};
+CodeGenerator_DB::generateUtilities() {
+    string hName = cppStubDirName + "/DB_Utilities.h";
+    OutputFile ofs{hName};
 
-    //--------------------------------------------------
-    // Header portion.
-    //--------------------------------------------------
     ofs << "#pragma once" << endl
         << endl
+        << "#include <charconv>" << endl
+        << "#include <optional>" << endl
         << "#include <string>" << endl
         << "#include <vector>" << endl
-        << "#include <memory>" << endl
         << endl
-        << "#include <pqxx/pqxx>" << endl
+        << "#include <pqxx/except>" << endl
         << endl
-        << "#include <" << cppIncludePath << baseClassName << ".h>" << endl;
-            ;
 
-    //--------------------------------------------------
-    // Opening. This defines the beginning of the class
-    // plus a bunch of standard methods.
-    //--------------------------------------------------
-    ofs << "class " << myClassName << " {" << endl
-        << "private:" << endl
-        << "\t/** Read all rows from query results. */" << endl
-        << "\tstatic " << baseClassName << "::Vector parseAll(pqxx::result &);"  << endl
+        << "/**" << endl
+        << " * COPY has no nullif(), so these give stream_to the same NULLs that" << endl
+        << " * nullif($1, '') and nullif($1, 0) produce in our INSERT statements." << endl
+        << " */" << endl
+        << "inline std::optional<std::string> nullIfEmpty(const std::string &value) {" << endl
+        << "\treturn value.empty() ? std::nullopt : std::optional<std::string>{value};" << endl
+        << "}" << endl
         << endl
-        << "\t/** Read one row from query results. */" << endl
-        << "\tstatic " << baseClassName << "::Pointer parseOne(pqxx::row &);"  << endl
+        << "template<typename T>" << endl
+        << "std::optional<T> nullIfZero(T value) {" << endl
+        << "\treturn value == 0 ? std::nullopt : std::optional<T>{value};" << endl
+        << "}" << endl
         << endl
-        << "\t/** Insert one row. */" << endl
-        << "\tstatic void doInsert(pqxx::connection &, " << baseClassName << " &);"  << endl
+
+        << "/**" << endl
+        << " * With the fastParse option, readers convert fields with these instead of" << endl
+        << " * as<T>(). They work on the field's text in place with std::from_chars. Like" << endl
+        << " * as<T>(), they throw pqxx::conversion_error if the text doesn't fit the type." << endl
+        << " */" << endl
+        << "template<typename T>" << endl
+        << "T fromText(const char *text, size_t length) {" << endl
+        << "\tT value {};" << endl
+        << "\tstd::from_chars_result result = std::from_chars(text, text + length, value);" << endl
+        << "\tif (result.ec != std::errc{} || result.ptr != text + length) {" << endl
+        << "\t\tthrow pqxx::conversion_error(\"Could not convert '\" + std::string(text, length) + \"'\");" << endl
+        << "\t}" << endl
+        << "\treturn value;" << endl
+        << "}" << endl
         << endl
-        << "\t/** Update one row. */" << endl
-        << "\tstatic void doUpdate(pqxx::connection &, " << baseClassName << " &);"  << endl
+        << "template<>" << endl
+        << "inline bool fromText<bool>(const char *text, size_t length) {" << endl
+        << "\tif (length != 1 || (text[0] != 't' && text[0] != 'f')) {" << endl
+        << "\t\tthrow pqxx::conversion_error(\"Could not convert '\" + std::string(text, length) + \"' to bool\");" << endl
+        << "\t}" << endl
+        << "\treturn text[0] == 't';" << endl
+        << "}" << endl
         << endl
-        << "public:" << endl
-        << "\tstatic " << baseClassName << "::Vector readAll(pqxx::connection &, std::string whereClause = \"\");"  << endl
-        << "\tstatic void update(pqxx::connection &, " << baseClassName << " &);"  << endl
-        << "\tstatic void deleteWithId(pqxx::connection &, int);"  << endl
+        << "template<>" << endl
+        << "inline std::string fromText<std::string>(const char *text, size_t length) {" << endl
+        << "\treturn std::string(text, length);" << endl
+        << "}" << endl
         << endl
+
+        << "/**" << endl
+        << " * The text form of an integer array, as in {1,2,3}, for col = ANY($1)." << endl
+        << " */" << endl
+        << "inline std::string toArrayLiteral(const std::vector<int> &values) {" << endl
+        << "\tstd::string retVal { \"{\" };" << endl
+        << "\tfor (size_t index = 0; index < values.size(); ++index) {" << endl
+        << "\t\tif (index > 0) {" << endl
+        << "\t\t\tretVal += ',';" << endl
+        << "\t\t}" << endl
+        << "\t\tretVal += std::to_string(values[index]);" << endl
+        << "\t}" << endl
+        << "\treturn retVal + '}';" << endl
+        << "}" << endl
            ;
+}
 
-    //--------------------------------------------------
-    // We also want readers based on having other
-    // tables pointed to us.
-    //--------------------------------------------------
-    generateH_FromForeignKeys(table, ofs, myClassName);
-    generateH_FromMapFiles(table, ofs, myClassName);
+/**
+ * This writes base/DB_ConnectionPool.h, a fixed-size pool of connections. Checkout
+ * claims a free slot with compare-and-swap, so it only takes a lock when every
+ * connection is in use. Connections open on first use, and each one gets every
+ * table's statements prepared. Connection strings come from the model's databases.
+ */
+void
+CodeGenerator_DB::generateConnectionPool() {
+    string hName = cppStubDirName + "/DB_ConnectionPool.h";
+    OutputFile ofs{hName};
 
-    //--------------------------------------------------
-    // Write a constexpr that holds the list of columns
-    // we'll query in any queries we write. We use a
-    // second one for inserts that skips the PK.
-    //--------------------------------------------------
-    string delim {""};
+    ofs << "#pragma once" << endl
+        << endl
+        << "#include <atomic>" << endl
+        << "#include <condition_variable>" << endl
+        << "#include <memory>" << endl
+        << "#include <mutex>" << endl
+        << "#include <optional>" << endl
+        << "#include <stdexcept>" << endl
+        << "#include <string>" << endl
+        << endl
+        << "#include <pqxx/pqxx>" << endl
+        << endl
+           ;
 
-    ofs << "\tstatic constexpr char const * QUERY_LIST { " << '"';
-    for (const Column::Pointer &column: table.getColumns()) {
-        ofs << delim << column->getDbName();
-        delim = ", ";
+    if (usePreparedStatements) {
+        for (const Table::Pointer &table: model.getTables()) {
+            ofs << "#include <" << cppIncludePath << "base/DB_" << table->getName() << "_Base.h>" << endl;
+        }
+        ofs << endl;
     }
-    ofs << '"' << " };" << endl;
 
-    delim = "";
-    ofs << "\tstatic constexpr char const * INSERT_LIST { " << '"';
-    for (const Column::Pointer &column: table.getColumns()) {
-        if (!column->getIsPrimaryKey()) {
-            ofs << delim << column->getDbName();
-            delim = ", ";
+    ofs << "/**" << endl
+        << " * A fixed number of connections shared between threads. acquire() hands out a" << endl
+        << " * Lease, which gives the connection back when it goes out of scope:" << endl
+        << " *" << endl
+        << " *     DB_ConnectionPool pool { " << exampleConnectionString() << " };" << endl
+        << " *     DB_ConnectionPool::Lease lease = pool.acquire();" << endl
+        << " *     Foo::Vector vec = DB_Foo::readAll(*lease);" << endl
+        << " */" << endl
+        << "class DB_ConnectionPool {" << endl
+        << "private:" << endl
+        << "\tclass Slot {" << endl
+        << "\tpublic:" << endl
+        << "\t\tstd::unique_ptr<pqxx::connection> connection;" << endl
+        << "\t\tstd::atomic<bool> busy { false };" << endl
+        << "\t};" << endl
+        << endl
+        << "public:" << endl
+        << "\t/** A connection checked out of the pool. It goes back when the Lease is destroyed. */" << endl
+        << "\tclass Lease {" << endl
+        << "\tpublic:" << endl
+        << "\t\tLease(DB_ConnectionPool &_pool, Slot &_slot): pool(&_pool), slot(&_slot) {}" << endl
+        << "\t\tLease(Lease &&other): pool(other.pool), slot(other.slot) { other.slot = nullptr; }" << endl
+        << "\t\tLease(const Lease &) = delete;" << endl
+        << "\t\tLease & operator=(const Lease &) = delete;" << endl
+        << "\t\t~Lease() {" << endl
+        << "\t\t\tif (slot != nullptr) {" << endl
+        << "\t\t\t\tpool->release(*slot);" << endl
+        << "\t\t\t}" << endl
+        << "\t\t}" << endl
+        << endl
+        << "\t\tpqxx::connection & operator*() const { return *slot->connection; }" << endl
+        << "\t\tpqxx::connection * operator->() const { return slot->connection.get(); }" << endl
+        << endl
+        << "\tprivate:" << endl
+        << "\t\tDB_ConnectionPool * pool;" << endl
+        << "\t\tSlot * slot;" << endl
+        << "\t};" << endl
+        << endl
+        << "\tDB_ConnectionPool(const std::string &_connectionString, size_t _size = " << poolSize << ")" << endl
+        << "\t\t: connectionString(_connectionString), size(_size), slots(new Slot[_size]) {}" << endl
+        << endl
+        << "\tDB_ConnectionPool(const DB_ConnectionPool &) = delete;" << endl
+        << "\tDB_ConnectionPool & operator=(const DB_ConnectionPool &) = delete;" << endl
+        << endl
+        << "\t/** Wait for a free connection. */" << endl
+        << "\tLease acquire() {" << endl
+        << "\t\tSlot * slot = claim();" << endl
+        << "\t\tif (slot == nullptr) {" << endl
+        << "\t\t\tstd::unique_lock<std::mutex> lock { waitMutex };" << endl
+        << "\t\t\tWaitCount counted { waiting };" << endl
+        << "\t\t\treleased.wait(lock, [&] { return (slot = claim()) != nullptr; });" << endl
+        << "\t\t}" << endl
+        << endl
+        << "\t\t// Opening can take a while, and release() takes waitMutex if it fails, so not under the lock." << endl
+        << "\t\treturn leaseFor(*slot);" << endl
+        << "\t}" << endl
+        << endl
+        << "\t/** Take a free connection if there is one, without waiting. */" << endl
+        << "\tstd::optional<Lease> tryAcquire() {" << endl
+        << "\t\tSlot * slot = claim();" << endl
+        << "\t\tif (slot == nullptr) {" << endl
+        << "\t\t\treturn std::nullopt;" << endl
+        << "\t\t}" << endl
+        << "\t\treturn leaseFor(*slot);" << endl
+        << "\t}" << endl
+        << endl
+        << "\tsize_t getSize() const { return size; }" << endl
+        << endl
+        << "\t/** Register every table's prepared statements. The pool does this for each new connection. */" << endl
+        << "\tstatic void prepareAll(pqxx::connection &" << (usePreparedStatements ? "conn" : "") << ") {" << endl
+           ;
+
+    if (usePreparedStatements) {
+        for (const Table::Pointer &table: model.getTables()) {
+            ofs << "\t\tDB_" << table->getName() << "_Base::prepare(conn);" << endl;
         }
     }
-    ofs << '"' << " };" << endl;
 
-    delim = "";
-    ofs << "\tstatic constexpr char const * QUALIFIED_QUERY_LIST { " << '"';
-    for (const Column::Pointer &column: table.getColumns()) {
-        ofs << delim << table.getDbName() << "." << column->getDbName();
-        delim = ", ";
+    ofs << "\t}" << endl
+        << endl
+        << "\t/** The connection string for one of the model's databases, by envName. */" << endl
+        << "\tstatic std::string connectionStringFor(const std::string &envName) {" << endl
+           ;
+
+    for (const DataModel::Database::Pointer &db: model.getDatabases()) {
+        string str;
+        if (!db->getHost().empty()) {
+            str += " host=" + connectionValue(db->getHost());
+        }
+        if (db->getPort() > 0) {
+            str += " port=" + std::to_string(db->getPort());
+        }
+        if (!db->getDbName().empty()) {
+            str += " dbname=" + connectionValue(db->getDbName());
+        }
+        if (!db->getUsername().empty()) {
+            str += " user=" + connectionValue(db->getUsername());
+        }
+        if (!db->getPassword().empty()) {
+            str += " password=" + connectionValue(db->getPassword());
+        }
+
+        ofs << "\t\tif (envName == \"" << db->getEnvName() << "\") {" << endl
+            << "\t\t\treturn \"" << (str.empty() ? str : str.substr(1)) << "\";" << endl
+            << "\t\t}" << endl
+               ;
     }
-    ofs << '"' << " };" << endl;
 
-    //--------------------------------------------------
-    // And close it out.
-    //--------------------------------------------------
-    ofs << "};" << endl;
+    ofs << "\t\tthrow std::invalid_argument(\"No database for environment \" + envName);" << endl
+        << "\t}" << endl
+        << endl
+        << "private:" << endl
+        << "\t/** Counts a waiter for as long as it's in scope, even if the wait throws. */" << endl
+        << "\tclass WaitCount {" << endl
+        << "\tpublic:" << endl
+        << "\t\tWaitCount(std::atomic<int> &_count): count(_count) { ++count; }" << endl
+        << "\t\t~WaitCount() { --count; }" << endl
+        << endl
+        << "\tprivate:" << endl
+        << "\t\tstd::atomic<int> &count;" << endl
+        << "\t};" << endl
+        << endl
+        << "\t/** Mark a free slot busy with compare-and-swap, and return it, or nullptr if they're all busy. */" << endl
+        << "\tSlot * claim() {" << endl
+        << "\t\tsize_t start = next.fetch_add(1, std::memory_order_relaxed);" << endl
+        << "\t\tfor (size_t count = 0; count < size; ++count) {" << endl
+        << "\t\t\tSlot &slot = slots[(start + count) % size];" << endl
+        << "\t\t\tbool expected = false;" << endl
+        << "\t\t\tif (slot.busy.compare_exchange_strong(expected, true)) {" << endl
+        << "\t\t\t\treturn &slot;" << endl
+        << "\t\t\t}" << endl
+        << "\t\t}" << endl
+        << "\t\treturn nullptr;" << endl
+        << "\t}" << endl
+        << endl
+        << "\t/** Lease out a slot we've claimed. If its connection won't open, the slot goes back. */" << endl
+        << "\tLease leaseFor(Slot &slot) {" << endl
+        << "\t\ttry {" << endl
+        << "\t\t\topen(slot);" << endl
+        << "\t\t}" << endl
+        << "\t\tcatch (...) {" << endl
+        << "\t\t\trelease(slot);" << endl
+        << "\t\t\tthrow;" << endl
+        << "\t\t}" << endl
+        << "\t\treturn Lease { *this, slot };" << endl
+        << "\t}" << endl
+        << endl
+        << "\t/** Open the slot's connection if it isn't, or if it has dropped. We hold the slot. */" << endl
+        << "\tvoid open(Slot &slot) {" << endl
+        << "\t\tif (slot.connection == nullptr || !slot.connection->is_open()) {" << endl
+        << "\t\t\tslot.connection = std::make_unique<pqxx::connection>(connectionString);" << endl
+        << "\t\t\tprepareAll(*slot.connection);" << endl
+        << "\t\t}" << endl
+        << "\t}" << endl
+        << endl
+        << "\t/**" << endl
+        << "\t * Free the slot, then wake a waiter if there is one. Every access to busy and waiting" << endl
+        << "\t * is seq_cst, so either we see the waiter's count or it sees the slot free." << endl
+        << "\t */" << endl
+        << "\tvoid release(Slot &slot) {" << endl
+        << "\t\tslot.busy.store(false);" << endl
+        << "\t\tif (waiting.load() > 0) {" << endl
+        << "\t\t\tstd::lock_guard<std::mutex> lock { waitMutex };" << endl
+        << "\t\t\treleased.notify_one();" << endl
+        << "\t\t}" << endl
+        << "\t}" << endl
+        << endl
+        << "\tstd::string connectionString;" << endl
+        << "\tsize_t size;" << endl
+        << "\tstd::unique_ptr<Slot[]> slots;" << endl
+        << "\tstd::atomic<size_t> next { 0 };" << endl
+        << endl
+        << "\t// Only used when every connection is busy." << endl
+        << "\tstd::mutex waitMutex;" << endl
+        << "\tstd::condition_variable released;" << endl
+        << "\tstd::atomic<int> waiting { 0 };" << endl
+        << "};" << endl
+           ;
 }
 
 /**
- * We want "readAll" style methods for any foreign keys we hold. For instance, assume:
- *
- * 		Foo.id
- * 		Bar.fooId -> Foo.id
- *
- * We want a readAll_ForFoo(connection, foo.id) to return all Bars that belong to Foo.
+ * This writes base/DB_Cache.h, the sharded LRU behind each DB_Foo_Cached. Each shard
+ * has its own lock, list and index, so threads reading different rows rarely meet.
  */
 void
-CodeGenerator_DB::generateH_FromForeignKeys(Table &table, std::ostream &ofs, const std::string &) {
-    string baseClassName = table.getName();
-
-    for (const Column::Pointer &column: table.getColumns()) {
-        Column::Pointer fk = column->getReferences();
-        if (fk != nullptr) {
-            std::shared_ptr<Table> refTable = fk->getOurTable().lock();
-            string refPtrName = firstUpper(column->getRefPtrName());
-
-            if (refPtrName.empty()) {
-                refPtrName = firstUpper(refTable->getName());
-            }
+CodeGenerator_DB::generateCache() {
+    string hName = cppStubDirName + "/DB_Cache.h";
+    OutputFile ofs{hName};
 
-            ofs << "\tstatic " << baseClassName << "::Vector readAll_For" << refPtrName << "(pqxx::connection &, int);"  << endl;
-        }
-    }
+    ofs << "#pragma once" << endl
+        << endl
+        << "#include <algorithm>" << endl
+        << "#include <cstdint>" << endl
+        << "#include <functional>" << endl
+        << "#include <list>" << endl
+        << "#include <memory>" << endl
+        << "#include <mutex>" << endl
+        << "#include <unordered_map>" << endl
+        << "#include <utility>" << endl
+        << "#include <vector>" << endl
+        << endl
+        << "/**" << endl
+        << " * A bounded cache, split into shards by the key's hash. Each shard is an LRU list" << endl
+        << " * with its own lock and its own share of the capacity." << endl
+        << " *" << endl
+        << " * A miss that goes to the database should take epochFor(key) first and pass it to" << endl
+        << " * put(). If anything in that shard was erased in between, put() drops the value, so" << endl
+        << " * a row read before a write can't land in the cache after it." << endl
+        << " */" << endl
+        << "template <class Key, class Value>" << endl
+        << "class DB_Cache {" << endl
+        << "public:" << endl
+        << "\tDB_Cache(size_t capacity, size_t shardCount)" << endl
+        << "\t\t: shardCapacity(std::max<size_t>(1, (capacity + std::max<size_t>(1, shardCount) - 1) / std::max<size_t>(1, shardCount)))" << endl
+        << "\t{" << endl
+        << "\t\tfor (size_t index = 0; index < std::max<size_t>(1, shardCount); ++index) {" << endl
+        << "\t\t\tshards.push_back(std::make_unique<Shard>());" << endl
+        << "\t\t}" << endl
+        << "\t}" << endl
+        << endl
+        << "\t/** Look this key up, making it the most recently used. */" << endl
+        << "\tbool get(const Key &key, Value &value) {" << endl
+        << "\t\tShard &shard = shardFor(key);" << endl
+        << "\t\tstd::lock_guard<std::mutex> lock { shard.mutex };" << endl
+        << "\t\tauto iter = shard.index.find(key);" << endl
+        << "\t\tif (iter == shard.index.end()) {" << endl
+        << "\t\t\t++shard.misses;" << endl
+        << "\t\t\treturn false;" << endl
+        << "\t\t}" << endl
+        << "\t\tshard.entries.splice(shard.entries.begin(), shard.entries, iter->second);" << endl
+        << "\t\tvalue = iter->second->second;" << endl
+        << "\t\t++shard.hits;" << endl
+        << "\t\treturn true;" << endl
+        << "\t}" << endl
+        << endl
+        << "\tuint64_t epochFor(const Key &key) {" << endl
+        << "\t\tShard &shard = shardFor(key);" << endl
+        << "\t\tstd::lock_guard<std::mutex> lock { shard.mutex };" << endl
+        << "\t\treturn shard.epoch;" << endl
+        << "\t}" << endl
+        << endl
+        << "\t/** Add or replace this entry, unless its shard has seen an erase since epochFor(). */" << endl
+        << "\tvoid put(const Key &key, const Value &value, uint64_t epoch) {" << endl
+        << "\t\tShard &shard = shardFor(key);" << endl
+        << "\t\tstd::lock_guard<std::mutex> lock { shard.mutex };" << endl
+        << "\t\tif (shard.epoch != epoch) {" << endl
+        << "\t\t\treturn;" << endl
+        << "\t\t}" << endl
+        << endl
+        << "\t\tauto iter = shard.index.find(key);" << endl
+        << "\t\tif (iter != shard.index.end()) {" << endl
+        << "\t\t\titer->second->second = value;" << endl
+        << "\t\t\tshard.entries.splice(shard.entries.begin(), shard.entries, iter->second);" << endl
+        << "\t\t\treturn;" << endl
+        << "\t\t}" << endl
+        << endl
+        << "\t\tshard.entries.emplace_front(key, value);" << endl
+        << "\t\tshard.index[key] = shard.entries.begin();" << endl
+        << "\t\tif (shard.entries.size() > shardCapacity) {" << endl
+        << "\t\t\tshard.index.erase(shard.entries.back().first);" << endl
+        << "\t\t\tshard.entries.pop_back();" << endl
+        << "\t\t}" << endl
+        << "\t}" << endl
+        << endl
+        << "\tvoid erase(const Key &key) {" << endl
+        << "\t\tShard &shard = shardFor(key);" << endl
+        << "\t\tstd::lock_guard<std::mutex> lock { shard.mutex };" << endl
+        << "\t\t++shard.epoch;" << endl
+        << "\t\tauto iter = shard.index.find(key);" << endl
+        << "\t\tif (iter != shard.index.end()) {" << endl
+        << "\t\t\tshard.entries.erase(iter->second);" << endl
+        << "\t\t\tshard.index.erase(iter);" << endl
+        << "\t\t}" << endl
+        << "\t}" << endl
+        << endl
+        << "\tvoid clear() {" << endl
+        << "\t\tfor (std::unique_ptr<Shard> &shard: shards) {" << endl
+        << "\t\t\tstd::lock_guard<std::mutex> lock { shard->mutex };" << endl
+        << "\t\t\t++shard->epoch;" << endl
+        << "\t\t\tshard->entries.clear();" << endl
+        << "\t\t\tshard->index.clear();" << endl
+        << "\t\t}" << endl
+        << "\t}" << endl
+        << endl
+        << "\tsize_t size() const { return sum([](const Shard &shard) { return shard.entries.size(); }); }" << endl
+        << "\tsize_t getCapacity() const { return shardCapacity * shards.size(); }" << endl
+        << "\tuint64_t getHits() const { return sum([](const Shard &shard) { return shard.hits; }); }" << endl
+        << "\tuint64_t getMisses() const { return sum([](const Shard &shard) { return shard.misses; }); }" << endl
+        << endl
+        << "\tvoid resetCounters() {" << endl
+        << "\t\tfor (std::unique_ptr<Shard> &shard: shards) {" << endl
+        << "\t\t\tstd::lock_guard<std::mutex> lock { shard->mutex };" << endl
+        << "\t\t\tshard->hits = 0;" << endl
+        << "\t\t\tshard->misses = 0;" << endl
+        << "\t\t}" << endl
+        << "\t}" << endl
+        << endl
+        << "private:" << endl
+        << "\tclass Shard {" << endl
+        << "\tpublic:" << endl
+        << "\t\tmutable std::mutex mutex;" << endl
+        << endl
+        << "\t\t/** Most recently used first. */" << endl
+        << "\t\tstd::list<std::pair<Key, Value>> entries;" << endl
+        << "\t\tstd::unordered_map<Key, typename std::list<std::pair<Key, Value>>::iterator> index;" << endl
+        << endl
+        << "\t\t/** Bumped by every erase. */" << endl
+        << "\t\tuint64_t epoch = 0;" << endl
+        << endl
+        << "\t\t// Kept per shard, under its lock, so counting doesn't make threads share a cache line." << endl
+        << "\t\tuint64_t hits = 0;" << endl
+        << "\t\tuint64_t misses = 0;" << endl
+        << "\t};" << endl
+        << endl
+        << "\tShard & shardFor(const Key &key) { return *shards[std::hash<Key>{}(key) % shards.size()]; }" << endl
+        << endl
+        << "\ttemplate <class Fn>" << endl
+        << "\tuint64_t sum(Fn fn) const {" << endl
+        << "\t\tuint64_t total = 0;" << endl
+        << "\t\tfor (const std::unique_ptr<Shard> &shard: shards) {" << endl
+        << "\t\t\tstd::lock_guard<std::mutex> lock { shard->mutex };" << endl
+        << "\t\t\ttotal += fn(*shard);" << endl
+        << "\t\t}" << endl
+        << "\t\treturn total;" << endl
+        << "\t}" << endl
+        << endl
+        << "\tstd::vector<std::unique_ptr<Shard>> shards;" << endl
+        << "\tsize_t shardCapacity;" << endl
+        << "};" << endl
+           ;
 }
 
 /**
- * Map tables provide many-to-many relationships. Imagine:
- *
- * Foo.id
- * Bar.id
- * Foo_Bar.fooId and Foo_Bar.barId
- *
- * If we have a Foo, we might want all Bars, which is a join against the Foo_Bar table.
- *
- * Map Tables probably have exactly three columns -- the two listed above plus a primary
- * key. What I'll need to do is see if another table looks like a map table mapped to
- * this table. If so, then I'll need the reference for the OTHER table (what we're
- * mapping from) and create a readAll method from that table's PK.
+ * This writes base/DB_NotifyListener.h. It listens on its own connection for the
+ * notifications from the SQL generators' notifyTriggers option, and with the cache
+ * option it invalidates the matching DB_Foo_Cached rows.
  */
 void
-CodeGenerator_DB::generateH_FromMapFiles(Table &table, std::ostream &ofs, const std::string &myClassName) {
-    string baseClassName = table.getName();
+CodeGenerator_DB::generateNotifyListener() {
+    string hName = cppStubDirName + "/DB_NotifyListener.h";
+    OutputFile ofs{hName};
+
+    // The SQL generators only give tables with primary keys a trigger.
+    std::vector<Table::Pointer> tables;
+    for (const Table::Pointer &table: model.getTables()) {
+        if (table->findPrimaryKey() != nullptr) {
+            tables.push_back(table);
+        }
+    }
 
-    for (const Table::Pointer &thisTable: model.getTables()) {
-        if (thisTable->getName() != table.getName() && thisTable->looksLikeMapTableFor(table)) {
-            const Column::Pointer otherRef = thisTable->otherMapTableReference(table);
-            if (otherRef == nullptr) {
-                continue;
-            }
+    ofs << "#pragma once" << endl
+        << endl
+        << "#include <atomic>" << endl
+        << "#include <charconv>" << endl
+        << "#include <chrono>" << endl
+        << "#include <cstdint>" << endl
+        << "#include <exception>" << endl
+        << "#include <functional>" << endl
+        << "#include <memory>" << endl
+        << "#include <set>" << endl
+        << "#include <string>" << endl
+        << "#include <thread>" << endl
+        << "#include <utility>" << endl
+        << "#include <vector>" << endl
+        << endl
+        << "#include <pqxx/pqxx>" << endl
+        << endl
+           ;
 
-            // We're just writing the signature:
-            //    vec readAll_FromMap_<MapTable>(pqxx::connection &, int otherId)
-            ofs << "\tstatic " << baseClassName << "::Vector readAll_FromMap_"
-                << thisTable->getName() << "(pqxx::connection &, int "
-                << otherRef->getName() << ");"  << endl;
+    if (wantCache) {
+        for (const Table::Pointer &table: tables) {
+            ofs << "#include <" << cppIncludePath << "base/DB_" << table->getName() << "_Cached.h>" << endl;
         }
+        ofs << endl;
     }
-}
-
-/**
- * Generate the .cpp file.
- */
-void
-CodeGenerator_DB::generateCPP(Table &table) {
-    string baseClassName = table.getName();
-    string myClassName = string{"DB_"} + baseClassName + "_Base";
-    string cName = cppStubDirName + "/" + myClassName + ".cpp";
-    std::ofstream ofs{cName};
-    const Column::Pointer pk = table.findPrimaryKey();
 
-    ofs << "#include <iostream>" << endl
+    ofs << "/**" << endl
+        << " * Listens, on a connection of its own, for the notifications each table's trigger sends" << endl
+        << " * when a row changes, so caches in several processes stay current without expiring" << endl
+        << " * entries on a timer:" << endl
+        << " *" << endl
+        << " *     DB_NotifyListener listener { " << exampleConnectionString() << " };" << endl
+        << " *     listener.start();" << endl
+        << " *" << endl
+        << " * Notifications that arrive together are handled as one batch, once for each distinct" << endl
+        << " * change. If the connection drops we reconnect, and as we can't know what we missed," << endl
+        << " * we treat everything as changed." << endl
+        << " */" << endl
+        << "class DB_NotifyListener {" << endl
+        << "public:" << endl
+        << "\t/**" << endl
+        << "\t * Called for each change in a batch, after the caches. operation is 'I', 'U' or 'D'." << endl
+        << "\t * After each (re)connect it's called once with '*', meaning anything may have changed." << endl
+        << "\t */" << endl
+        << "\ttypedef std::function<void(const std::string &channel, char operation, int id)> Callback;" << endl
         << endl
-        << "#include <" << cppIncludePath << "base/" << myClassName << ".h>" << endl
+        << "\tDB_NotifyListener(const std::string &_connectionString, Callback _callback = nullptr)" << endl
+        << "\t\t: connectionString(_connectionString), callback(_callback) {}" << endl
         << endl
-        << "using std::string;" << endl
+        << "\tDB_NotifyListener(const DB_NotifyListener &) = delete;" << endl
+        << "\tDB_NotifyListener & operator=(const DB_NotifyListener &) = delete;" << endl
         << endl
-       ;
+        << "\t~DB_NotifyListener() { stop(); }" << endl
+        << endl
+        << "\t/** Run in a thread of our own until stop(). */" << endl
+        << "\tvoid start() {" << endl
+        << "\t\tif (!thread.joinable()) {" << endl
+        << "\t\t\tstopping = false;" << endl
+        << "\t\t\tthread = std::thread([this] { run(); });" << endl
+        << "\t\t}" << endl
+        << "\t}" << endl
+        << endl
+        << "\t/** This can take up to a second, as we only check between waits. */" << endl
+        << "\tvoid stop() {" << endl
+        << "\t\tstopping = true;" << endl
+        << "\t\tif (thread.joinable()) {" << endl
+        << "\t\t\tthread.join();" << endl
+        << "\t\t}" << endl
+        << "\t}" << endl
+        << endl
+        << "\t/** Listen in this thread until stop() is called from another. This is what start() runs. */" << endl
+        << "\tvoid run() {" << endl
+        << "\t\twhile (!stopping) {" << endl
+        << "\t\t\ttry {" << endl
+        << "\t\t\t\tpqxx::connection conn { connectionString };" << endl
+        << "\t\t\t\tstd::vector<std::unique_ptr<Receiver>> receivers;" << endl
+        << "\t\t\t\tfor (const std::string &channel: channels()) {" << endl
+        << "\t\t\t\t\treceivers.push_back(std::make_unique<Receiver>(conn, channel, *this));" << endl
+        << "\t\t\t\t}" << endl
+        << endl
+        << "\t\t\t\t// Anything could have changed while we weren't listening." << endl
+        << "\t\t\t\tinvalidateAll();" << endl
+        << "\t\t\t\t++connects;" << endl
+        << endl
+        << "\t\t\t\twhile (!stopping) {" << endl
+        << "\t\t\t\t\tif (conn.await_notification(1, 0) == 0) {" << endl
+        << "\t\t\t\t\t\tcontinue;" << endl
+        << "\t\t\t\t\t}" << endl
+        << endl
+        << "\t\t\t\t\t// A burst of writes sends a burst of notifications. Collect them until it goes quiet." << endl
+        << "\t\t\t\t\twhile (pending.size() < MAX_BATCH && conn.await_notification(0, BATCH_WAIT_MICROS) > 0) {" << endl
+        << "\t\t\t\t\t}" << endl
+        << "\t\t\t\t\tflush();" << endl
+        << "\t\t\t\t}" << endl
+        << "\t\t\t}" << endl
+        << "\t\t\tcatch (const std::exception &) {" << endl
+        << "\t\t\t\t// A dropped connection, or anything else. Until we're back, nothing tells us of changes." << endl
+        << "\t\t\t\tpending.clear();" << endl
+        << "\t\t\t\tclearCaches();" << endl
+        << "\t\t\t\tstd::this_thread::sleep_for(std::chrono::seconds(1));" << endl
+        << "\t\t\t}" << endl
+        << "\t\t}" << endl
+        << "\t}" << endl
+        << endl
+        << "\tuint64_t getNotifications() const { return notifications.load(); }" << endl
+        << "\tuint64_t getBatches() const { return batches.load(); }" << endl
+        << "\tuint64_t getConnects() const { return connects.load(); }" << endl
+        << "\tuint64_t getCallbackErrors() const { return callbackErrors.load(); }" << endl
+        << endl
+        << "\t/** One channel per table, named by the table. */" << endl
+        << "\tstatic const std::vector<std::string> & channels() {" << endl
+        << "\t\tstatic const std::vector<std::string> theChannels {" << endl
+           ;
 
-    //--------------------------------------------------
-    // Generate the reader methods.
-    //--------------------------------------------------
-    generateCPP_ReadAll(table, ofs, myClassName);
-    generateCPP_ParseAll(table, ofs, myClassName);
+    for (const Table::Pointer &table: tables) {
+        ofs << "\t\t\t\"" << notifyChannelFor(*table) << "\"," << endl;
+    }
+
+    ofs << "\t\t};" << endl
+        << "\t\treturn theChannels;" << endl
+        << "\t}" << endl
+        << endl
+        << "private:" << endl
+        << "\tclass Receiver: public pqxx::notification_receiver {" << endl
+        << "\tpublic:" << endl
+        << "\t\tReceiver(pqxx::connection &conn, const std::string &channel, DB_NotifyListener &_listener)" << endl
+        << "\t\t\t: pqxx::notification_receiver(conn, channel), listener(_listener) {}" << endl
+        << endl
+        << "\t\tvoid operator()(const std::string &payload, int) override {" << endl
+        << "\t\t\tlistener.pending.emplace_back(channel(), payload);" << endl
+        << "\t\t}" << endl
+        << endl
+        << "\tprivate:" << endl
+        << "\t\tDB_NotifyListener &listener;" << endl
+        << "\t};" << endl
+        << endl
+        << "\t/** Handle a batch. The payloads are \"I:id\", \"U:id\" or \"D:id\". */" << endl
+        << "\tvoid flush() {" << endl
+        << "\t\tstd::set<std::pair<std::string, std::string>> distinct { pending.begin(), pending.end() };" << endl
+        << "\t\tnotifications += pending.size();" << endl
+        << "\t\t++batches;" << endl
+        << "\t\tpending.clear();" << endl
+        << endl
+        << "\t\tfor (const auto & [channel, payload] : distinct) {" << endl
+        << "\t\t\tint id = 0;" << endl
+        << "\t\t\tif (payload.size() < 3 || payload[1] != ':'" << endl
+        << "\t\t\t\t|| std::from_chars(payload.data() + 2, payload.data() + payload.size(), id).ec != std::errc{})" << endl
+        << "\t\t\t{" << endl
+        << "\t\t\t\tcontinue;" << endl
+        << "\t\t\t}" << endl
+           ;
+
+    if (wantCache) {
+        ofs << "\t\t\tinvalidate(channel, id);" << endl;
+    }
+
+    ofs << "\t\t\tif (callback) {" << endl
+        << "\t\t\t\tcallSafely(channel, payload[0], id);" << endl
+        << "\t\t\t}" << endl
+        << "\t\t}" << endl
+        << "\t}" << endl
+        << endl
+           ;
+
+    if (wantCache) {
+        ofs << "\tstatic void invalidate(const std::string &channel, int id) {" << endl;
+        string elseStr;
+        for (const Table::Pointer &table: tables) {
+            ofs << "\t\t" << elseStr << "if (channel == \"" << notifyChannelFor(*table) << "\") {" << endl
+                << "\t\t\t" << invalidateFor(*table, "id") << endl
+                << "\t\t}" << endl
+                   ;
+            elseStr = "else ";
+        }
+        ofs << "\t}" << endl
+            << endl
+               ;
+    }
+
+    ofs << "\t/** Each time we connect, as every row may have changed since we last listened. */" << endl
+        << "\tvoid invalidateAll() {" << endl
+        << "\t\tclearCaches();" << endl
+        << "\t\tif (callback) {" << endl
+        << "\t\t\tcallSafely(\"\", '*', 0);" << endl
+        << "\t\t}" << endl
+        << "\t}" << endl
+        << endl
+        << "\tstatic void clearCaches() {" << endl
+           ;
+
+    if (wantCache) {
+        for (const Table::Pointer &table: tables) {
+            ofs << "\t\tDB_" << table->getName() << "_Cached::clear();" << endl;
+        }
+    }
+
+    ofs << "\t}" << endl
+        << endl
+        << "\t/** The callback is the caller's code. If it throws, we count it and carry on listening. */" << endl
+        << "\tvoid callSafely(const std::string &channel, char operation, int id) {" << endl
+        << "\t\ttry {" << endl
+        << "\t\t\tcallback(channel, operation, id);" << endl
+        << "\t\t}" << endl
+        << "\t\tcatch (...) {" << endl
+        << "\t\t\t++callbackErrors;" << endl
+        << "\t\t}" << endl
+        << "\t}" << endl
+        << endl
+        << "\tstatic constexpr size_t MAX_BATCH = 10000;" << endl
+        << "\tstatic constexpr long BATCH_WAIT_MICROS = 10000;" << endl
+        << endl
+        << "\tstd::string connectionString;" << endl
+        << "\tCallback callback;" << endl
+        << "\tstd::thread thread;" << endl
+        << "\tstd::atomic<bool> stopping { false };" << endl
+        << endl
+        << "\t/** Filled by the receivers while we wait, and only touched by our thread. */" << endl
+        << "\tstd::vector<std::pair<std::string, std::string>> pending;" << endl
+        << endl
+        << "\tstd::atomic<uint64_t> notifications { 0 };" << endl
+        << "\tstd::atomic<uint64_t> batches { 0 };" << endl
+        << "\tstd::atomic<uint64_t> connects { 0 };" << endl
+        << "\tstd::atomic<uint64_t> callbackErrors { 0 };" << endl
+        << "};" << endl
+           ;
+}
+
+/**
+ * With the cache option, this writes base/DB_Foo_Cached.h and .cpp. DB_Foo_Cached
+ * keeps one process-wide cache of rows by primary key, and readById() reads through
+ * it. DB_Foo_Base's writers invalidate the rows they touch, after the write, so a
+ * FOR SHARE read that misses waits for the writer's commit.
+ */
+void
+CodeGenerator_DB::generateCached(Table &table) {
+    string baseClassName = table.getName();
+    string myClassName = string{"DB_"} + baseClassName + "_Cached";
+    string dbClassName = string{"DB_"} + baseClassName + "_Base";
+    const Column::Pointer pk = table.findPrimaryKey();
+
+    {
+        OutputFile ofs{cppStubDirName + "/" + myClassName + ".h"};
+
+        ofs << "#pragma once" << endl
+            << endl
+            << "#include <memory>" << endl
+            << endl
+            << "#include <pqxx/pqxx>" << endl
+            << endl
+            << "#include <" << cppIncludePath << "base/DB_Cache.h>" << endl
+            << "#include <" << cppIncludePath << baseClassName << ".h>" << endl
+            << endl
+            << "/**" << endl
+            << " * A read-through cache of " << baseClassName << " rows by primary key, shared by the whole process." << endl
+            << " * " << dbClassName << " invalidates a row whenever it writes it. Only the connection form" << endl
+            << " * of readById() fills the cache, as it only keeps rows it has seen committed. Rows come" << endl
+            << " * back as pointers to const, as other threads may hold the same one. Copy a row to change it." << endl
+            << " */" << endl
+            << "class " << myClassName << " {" << endl
+            << "public:" << endl
+            << "\ttypedef std::shared_ptr<const " << baseClassName << "> ConstPointer;" << endl
+            << "\ttypedef DB_Cache<int, ConstPointer> Cache;" << endl
+            << endl
+            << "\t/** The row with this primary key, or nullptr if there isn't one. */" << endl
+            << "\tstatic ConstPointer readById(pqxx::connection &, int id);" << endl
+            << "\tstatic ConstPointer readById(pqxx::transaction_base &, int id);" << endl
+            << endl
+            << "\tstatic void invalidate(int id) { cache().erase(id); }" << endl
+            << "\tstatic void clear() { cache().clear(); }" << endl
+            << endl
+            << "\t/** The cache itself, for its hit and miss counters. */" << endl
+            << "\tstatic Cache & cache();" << endl
+            << endl
+            << "private:" << endl
+            << "\tstatic ConstPointer read(pqxx::transaction_base &, int id, bool forShare);" << endl
+            << "};" << endl
+               ;
+    }
+
+    OutputFile ofs{cppStubDirName + "/" + myClassName + ".cpp"};
+
+    ofs << "#include <" << cppIncludePath << "base/" << myClassName << ".h>" << endl
+        << "#include <" << cppIncludePath << "base/" << dbClassName << ".h>" << endl
+        << endl
+        << "using std::string;" << endl
+        << endl
+        << myClassName << "::Cache & " << myClassName << "::cache() {" << endl
+        << "\tstatic Cache theCache { " << cacheCapacity << ", " << cacheShards << " };" << endl
+        << "\treturn theCache;" << endl
+        << "}" << endl
+        << endl
+        << "/**" << endl
+        << " * Inside a transaction we go straight to the database. The cache may not hold what" << endl
+        << " * this transaction has written, and we mustn't keep a row that may yet be rolled back." << endl
+        << " */" << endl
+        << myClassName << "::ConstPointer " << myClassName << "::readById(pqxx::transaction_base &work, int id) {" << endl
+        << "\treturn read(work, id, false);" << endl
+        << "}" << endl
+        << endl
+        << "/**" << endl
+        << " * A hit doesn't need a transaction, so we only open one on a miss. The read is FOR SHARE," << endl
+        << " * so it waits out any uncommitted write to the row. We keep the row only once we've" << endl
+        << " * committed, and only if nobody invalidated it since we started." << endl
+        << " */" << endl
+        << myClassName << "::ConstPointer " << myClassName << "::readById(pqxx::connection &conn, int id) {" << endl
+        << "\tConstPointer ptr;" << endl
+        << "\tif (cache().get(id, ptr)) {" << endl
+        << "\t\treturn ptr;" << endl
+        << "\t}" << endl
+        << endl
+        << "\tuint64_t epoch = cache().epochFor(id);" << endl
+        << "\tpqxx::work work {conn};" << endl
+        << "\tptr = read(work, id, true);" << endl
+        << "\twork.commit();" << endl
+        << "\tif (ptr != nullptr) {" << endl
+        << "\t\tcache().put(id, ptr, epoch);" << endl
+        << "\t}" << endl
+        << "\treturn ptr;" << endl
+        << "}" << endl
+        << endl
+        << myClassName << "::ConstPointer " << myClassName << "::read(pqxx::transaction_base &work, int id, bool forShare) {" << endl
+           ;
+
+    if (usePreparedStatements) {
+        ofs << "\tpqxx::result results = forShare" << endl
+            << "\t\t? work.exec_prepared(\"" << statementName(table, "readById_ForShare") << "\", id)" << endl
+            << "\t\t: work.exec_prepared(\"" << statementName(table, "readById") << "\", id);" << endl
+               ;
+    }
+    else {
+        ofs << "\tpqxx::result results = work.exec_params( string{\"SELECT \"} + " << dbClassName << "::QUERY_LIST + \" FROM "
+            << table.getDbName() << " WHERE " << pk->getDbName() << " = $1\" + string{forShare ? \" FOR SHARE\" : \"\"}, id);" << endl;
+    }
+
+    ofs << "\t" << baseClassName << "::Vector vec = " << dbClassName << "::parseAll(results);" << endl
+        << "\treturn vec.empty() ? nullptr : ConstPointer { vec[0] };" << endl
+        << "}" << endl
+           ;
+}
+
+/**
+ * Generate the .h file.
+ */
+void
+CodeGenerator_DB::generateH(Table &table) {
+    string baseClassName = table.getName();
+    string myClassName = string{"DB_"} + baseClassName + "_Base";
+    string hName = cppStubDirName + "/" + myClassName + ".h";
+    OutputFile ofs{hName};
+
+    //--------------------------------------------------
+    // Header portion.
+    //--------------------------------------------------
+    ofs << "#pragma once" << endl
+        << endl
+        << "#include <string>" << endl
+        << "#include <vector>" << endl
+        << "#include <memory>" << endl
+        << "#include <functional>" << endl
+        << "#include <unordered_map>" << endl
+        << endl
+        << "#include <pqxx/pqxx>" << endl
+        << endl
+        << "#include <" << cppIncludePath << baseClassName << ".h>" << endl;
+            ;
+
+    if (wantValueTypes) {
+        ofs << "#include <" << cppIncludePath << "base/" << baseClassName << "_Value.h>" << endl;
+    }
+    if (wantColumnSnapshots) {
+        ofs << "#include <" << cppIncludePath << "base/" << baseClassName << "_Columns.h>" << endl;
+    }
+
+    //--------------------------------------------------
+    // Opening. This defines the beginning of the class
+    // plus a bunch of standard methods.
+    //--------------------------------------------------
+    ofs << "class " << myClassName << " {" << endl
+           ;
+
+    if (wantCache) {
+        ofs << "\t// Reads through our QUERY_LIST and parseAll()." << endl
+            << "\tfriend class DB_" << baseClassName << "_Cached;" << endl
+            << endl
+               ;
+    }
+
+    ofs << "private:" << endl
+        << "\t/** Read all rows from query results. */" << endl
+        << "\tstatic " << baseClassName << "::Vector parseAll(pqxx::result &);"  << endl
+        << endl
+        << "\t/** Read one row from query results. */" << endl
+        << "\tstatic " << baseClassName << "::Pointer parseOne(pqxx::row &);"  << endl
+        << endl
+        << "\t/** Insert one row. */" << endl
+        << "\tstatic void doInsert(pqxx::transaction_base &, " << baseClassName << " &);"  << endl
+        << endl
+        << "\t/** Update one row. */" << endl
+        << "\tstatic void doUpdate(pqxx::transaction_base &, " << baseClassName << " &);"  << endl
+        << endl
+           ;
+
+    if (dirtyTracking) {
+        ofs << "\t/** The UPDATE for just these columns, built once per combination. */" << endl
+            << "\tstatic const std::string & updateSqlFor(const " << baseClassName << "::DirtyColumns &);" << endl
+            << endl
+               ;
+    }
+
+    ofs << "public:" << endl
+        << "\t// Each method comes in two forms. The connection form runs in its own transaction" << endl
+        << "\t// and commits. The transaction_base form leaves the commit to the caller." << endl
+        << "\tstatic " << baseClassName << "::Vector readAll(pqxx::connection &, std::string whereClause = \"\");"  << endl
+        << "\tstatic " << baseClassName << "::Vector readAll(pqxx::transaction_base &, std::string whereClause = \"\");"  << endl
+        << "\tstatic void update(pqxx::connection &, " << baseClassName << " &);"  << endl
+        << "\tstatic void update(pqxx::transaction_base &, " << baseClassName << " &);"  << endl
+        << "\tstatic void deleteWithId(pqxx::connection &, int);"  << endl
+        << "\tstatic void deleteWithId(pqxx::transaction_base &, int);"  << endl
+        << endl
+           ;
+
+    if (wantValueTypes) {
+        ofs << "\t/** Read into plain structs stored contiguously, with no shared_ptr per row. */" << endl
+            << "\tstatic " << baseClassName << "_Value::Vector readAllValues(pqxx::connection &, std::string whereClause = \"\");" << endl
+            << "\tstatic " << baseClassName << "_Value::Vector readAllValues(pqxx::transaction_base &, std::string whereClause = \"\");" << endl
+            << endl
+               ;
+    }
+
+    if (wantColumnSnapshots) {
+        ofs << "\t/** Read into a column-oriented snapshot. */" << endl
+            << "\tstatic " << baseClassName << "_Columns readColumns(pqxx::connection &, std::string whereClause = \"\");" << endl
+            << "\tstatic " << baseClassName << "_Columns readColumns(pqxx::transaction_base &, std::string whereClause = \"\");" << endl
+            << endl
+               ;
+    }
+
+    ofs << "\t/** Stream rows through COPY, one callback per row. The object passed is reused for every row. */" << endl
+        << "\tstatic void readEach(pqxx::connection &, std::string whereClause, std::function<void(const " << baseClassName << " &)>);" << endl
+        << "\tstatic void readEach(pqxx::transaction_base &, std::string whereClause, std::function<void(const " << baseClassName << " &)>);" << endl
+        << endl
+        << "\t/** Insert all rows with COPY. Rows without a primary key get one from the table's sequence. */" << endl
+        << "\tstatic void insertAll(pqxx::connection &, " << baseClassName << "::Vector &);" << endl
+        << "\tstatic void insertAll(pqxx::transaction_base &, " << baseClassName << "::Vector &);" << endl
+        << endl
+        << "\t/** Insert the new rows and update the rest, a chunk of rows per statement. */" << endl
+        << "\tstatic void updateAll(pqxx::connection &, " << baseClassName << "::Vector &);" << endl
+        << "\tstatic void updateAll(pqxx::transaction_base &, " << baseClassName << "::Vector &);" << endl
+        << endl
+           ;
+
+    ofs << "\t// Pipelined readers. Queue reads on a pqxx::pipeline, then collect() each one. The" << endl
+        << "\t// queries go out together rather than one round trip apiece." << endl
+        << "\tstatic pqxx::pipeline::query_id queueReadAll(pqxx::pipeline &, std::string whereClause = \"\");" << endl
+           ;
+    for (const Column::Pointer &column: table.getColumns()) {
+        if (column->getReferences() != nullptr) {
+            ofs << "\tstatic pqxx::pipeline::query_id queueReadAll_For" << refPtrNameFor(*column) << "(pqxx::pipeline &, int);" << endl;
+        }
+    }
+    for (const Table::Pointer &mapTable: mapTablesFor(table)) {
+        ofs << "\tstatic pqxx::pipeline::query_id queueReadAll_FromMap_" << mapTable->getName() << "(pqxx::pipeline &, int);" << endl;
+    }
+    ofs << "\tstatic " << baseClassName << "::Vector collect(pqxx::pipeline &, pqxx::pipeline::query_id);" << endl
+        << endl
+           ;
+
+    ofs << "\t// Graph loading. readGraph() reads the matching rows, then depth levels of the rows" << endl
+        << "\t// that point at them, and links them with resolveReferences(). Each table's children" << endl
+        << "\t// are read in one pipeline, then each child table loads its own children in another." << endl
+        << "\tstatic " << baseClassName << "::Vector readGraph(pqxx::connection &, std::string whereClause, int depth = 1);" << endl
+        << "\tstatic " << baseClassName << "::Vector readGraph(pqxx::transaction_base &, std::string whereClause, int depth = 1);" << endl
+        << "\tstatic void loadChildren(pqxx::transaction_base &, " << baseClassName << "::Vector &, int depth = 1);" << endl
+           ;
+    for (const Table::Pointer &parent: parentTablesFor(table)) {
+        ofs << "\tstatic " << baseClassName << "::Vector readAll_ForAny" << parent->getName() << "(pqxx::connection &, const std::vector<int> &);" << endl
+            << "\tstatic " << baseClassName << "::Vector readAll_ForAny" << parent->getName() << "(pqxx::transaction_base &, const std::vector<int> &);" << endl
+            << "\tstatic pqxx::pipeline::query_id queueReadAll_ForAny" << parent->getName() << "(pqxx::pipeline &, const std::vector<int> &);" << endl
+               ;
+    }
+    ofs << endl;
+
+    for (const Column::Pointer &column: upsertColumnsFor(table)) {
+        string colName = firstUpper(column->getName());
+        ofs << "\t/** Insert, or update the row with the same " << column->getName() << ". Sets the primary key either way. */" << endl
+            << "\tstatic void upsert_By" << colName << "(pqxx::connection &, " << baseClassName << " &);" << endl
+            << "\tstatic void upsert_By" << colName << "(pqxx::transaction_base &, " << baseClassName << " &);" << endl
+            << "\tstatic void upsertAll_By" << colName << "(pqxx::connection &, " << baseClassName << "::Vector &);" << endl
+            << "\tstatic void upsertAll_By" << colName << "(pqxx::transaction_base &, " << baseClassName << "::Vector &);" << endl
+            << endl
+               ;
+    }
+
+    if (usePreparedStatements) {
+        ofs << "\t/** Register our named statements. Call once for each new connection. */" << endl
+            << "\tstatic void prepare(pqxx::connection &);" << endl
+            << endl
+               ;
+    }
+
+    //--------------------------------------------------
+    // Keyset pagination on the PK and each indexed column.
+    //--------------------------------------------------
+    const Column::Pointer pk = table.findPrimaryKey();
+    for (const Column::Pointer &column: pageColumnsFor(table)) {
+        string params = paramTypeFor(*column) + "after" + firstUpper(column->getName());
+        if (column != pk) {
+            params += ", int after" + firstUpper(pk->getName());
+        }
+
+        ofs << "\tstatic " << baseClassName << "::Vector readPage_By" << firstUpper(column->getName())
+                << "(pqxx::connection &, " << params << ", int limit);" << endl
+            << "\tstatic " << baseClassName << "::Vector readPage_By" << firstUpper(column->getName())
+                << "(pqxx::transaction_base &, " << params << ", int limit);" << endl
+               ;
+    }
+    ofs << endl;
+
+    //--------------------------------------------------
+    // We also want readers based on having other
+    // tables pointed to us.
+    //--------------------------------------------------
+    generateH_FromForeignKeys(table, ofs, myClassName);
+    generateH_FromMapFiles(table, ofs, myClassName);
+
+    //--------------------------------------------------
+    // Write a constexpr that holds the list of columns
+    // we'll query in any queries we write. We use a
+    // second one for inserts that skips the PK.
+    //--------------------------------------------------
+    string delim {""};
+
+    ofs << "\tstatic constexpr char const * QUERY_LIST { " << '"';
+    for (const Column::Pointer &column: table.getColumns()) {
+        ofs << delim << column->getDbName();
+        delim = ", ";
+    }
+    ofs << '"' << " };" << endl;
+
+    delim = "";
+    ofs << "\tstatic constexpr char const * INSERT_LIST { " << '"';
+    for (const Column::Pointer &column: table.getColumns()) {
+        if (!column->getIsPrimaryKey()) {
+            ofs << delim << column->getDbName();
+            delim = ", ";
+        }
+    }
+    ofs << '"' << " };" << endl;
+
+    delim = "";
+    ofs << "\tstatic constexpr char const * QUALIFIED_QUERY_LIST { " << '"';
+    for (const Column::Pointer &column: table.getColumns()) {
+        ofs << delim << table.getDbName() << "." << column->getDbName();
+        delim = ", ";
+    }
+    ofs << '"' << " };" << endl;
+
+    //--------------------------------------------------
+    // And close it out.
+    //--------------------------------------------------
+    ofs << "};" << endl;
+}
+
+/**
+ * We want "readAll" style methods for any foreign keys we hold. For instance, assume:
+ *
+ * 		Foo.id
+ * 		Bar.fooId -> Foo.id
+ *
+ * We want a readAll_ForFoo(connection, foo.id) to return all Bars that belong to Foo.
+ */
+void
+CodeGenerator_DB::generateH_FromForeignKeys(Table &table, std::ostream &ofs, const std::string &) {
+    string baseClassName = table.getName();
+
+    for (const Column::Pointer &column: table.getColumns()) {
+        Column::Pointer fk = column->getReferences();
+        if (fk != nullptr) {
+            string refPtrName = refPtrNameFor(*column);
+
+            ofs << "\tstatic " << baseClassName << "::Vector readAll_For" << refPtrName << "(pqxx::connection &, int);"  << endl
+                << "\tstatic " << baseClassName << "::Vector readAll_For" << refPtrName << "(pqxx::transaction_base &, int);"  << endl
+                << "\tstatic std::unordered_map<int, " << baseClassName << "::Vector> readAll_For" << refPtrName
+                    << "(pqxx::connection &, const std::vector<int> &);"  << endl
+                << "\tstatic std::unordered_map<int, " << baseClassName << "::Vector> readAll_For" << refPtrName
+                    << "(pqxx::transaction_base &, const std::vector<int> &);"  << endl;
+        }
+    }
+}
+
+/**
+ * Map tables provide many-to-many relationships. Imagine:
+ *
+ * Foo.id
+ * Bar.id
+ * Foo_Bar.fooId and Foo_Bar.barId
+ *
+ * If we have a Foo, we might want all Bars, which is a join against the Foo_Bar table.
+ *
+ * Map Tables probably have exactly three columns -- the two listed above plus a primary
+ * key. What I'll need to do is see if another table looks like a map table mapped to
+ * this table. If so, then I'll need the reference for the OTHER table (what we're
+ * mapping from) and create a readAll method from that table's PK.
+ */
+void
+CodeGenerator_DB::generateH_FromMapFiles(Table &table, std::ostream &ofs, const std::string &myClassName) {
+    string baseClassName = table.getName();
+
+    for (const Table::Pointer &thisTable: mapTablesFor(table)) {
+        const Column::Pointer otherRef = thisTable->otherMapTableReference(table);
+
+        // We're just writing the signature:
+        //    vec readAll_FromMap_<MapTable>(pqxx::connection &, int otherId)
+        ofs << "\tstatic " << baseClassName << "::Vector readAll_FromMap_"
+            << thisTable->getName() << "(pqxx::connection &, int "
+            << otherRef->getName() << ");"  << endl
+            << "\tstatic " << baseClassName << "::Vector readAll_FromMap_"
+            << thisTable->getName() << "(pqxx::transaction_base &, int "
+            << otherRef->getName() << ");"  << endl
+            << "\tstatic std::unordered_map<int, " << baseClassName << "::Vector> readAll_FromMap_"
+            << thisTable->getName() << "(pqxx::connection &, const std::vector<int> &);"  << endl
+            << "\tstatic std::unordered_map<int, " << baseClassName << "::Vector> readAll_FromMap_"
+            << thisTable->getName() << "(pqxx::transaction_base &, const std::vector<int> &);"  << endl;
+    }
+}
+
+/**
+ * Generate the .cpp file.
+ */
+void
+CodeGenerator_DB::generateCPP(Table &table) {
+    string baseClassName = table.getName();
+    string myClassName = string{"DB_"} + baseClassName + "_Base";
+    string cName = cppStubDirName + "/" + myClassName + ".cpp";
+    OutputFile ofs{cName};
+    const Column::Pointer pk = table.findPrimaryKey();
+
+    ofs << "#include <algorithm>" << endl
+        << "#include <iostream>" << endl
+           ;
+
+    if (!upsertColumnsFor(table).empty()) {
+        ofs << "#include <map>" << endl;
+    }
+    if (dirtyTracking) {
+        ofs << "#include <mutex>" << endl;
+    }
+
+    ofs << endl
+        << "#include <" << cppIncludePath << "base/" << myClassName << ".h>" << endl
+        << "#include <" << cppIncludePath << "base/DB_Utilities.h>" << endl
+        << "#include <" << cppIncludePath << "base/Utilities.h>" << endl
+           ;
+
+    for (const Table::Pointer &child: childTablesFor(table)) {
+        if (child->getName() != baseClassName) {
+            ofs << "#include <" << cppIncludePath << "base/DB_" << child->getName() << "_Base.h>" << endl;
+        }
+    }
+
+    if (nativeTime) {
+        ofs << "#include <" << cppIncludePath << "base/TimeUtilities.h>" << endl;
+    }
+    if (wantCache) {
+        ofs << "#include <" << cppIncludePath << "base/DB_" << baseClassName << "_Cached.h>" << endl;
+    }
+
+    ofs << endl
+        << "using std::string;" << endl
+        << endl
+       ;
+
+    //--------------------------------------------------
+    // Generate the reader methods.
+    //--------------------------------------------------
+    generateCPP_ReadAll(table, ofs, myClassName);
+    generateCPP_ReadEach(table, ofs, myClassName);
+    if (wantValueTypes) {
+        generateCPP_ReadAllValues(table, ofs, myClassName);
+    }
+    if (wantColumnSnapshots) {
+        generateCPP_ReadColumns(table, ofs, myClassName);
+    }
+    generateCPP_ReadPages(table, ofs, myClassName);
+    generateCPP_ParseAll(table, ofs, myClassName);
     generateCPP_ParseOne(table, ofs, myClassName);
 
-    generateCPP_FromForeignKeys(table, ofs, myClassName);
-    generateCPP_FromMapFiles(table, ofs, myClassName);
+    generateCPP_FromForeignKeys(table, ofs, myClassName);
+    generateCPP_FromMapFiles(table, ofs, myClassName);
+    generateCPP_QueueReaders(table, ofs, myClassName);
+    generateCPP_ReadGraph(table, ofs, myClassName);
+
+    //--------------------------------------------------
+    // Write the add-or-update method.
+    //--------------------------------------------------
+    string getterName { string{""} +  firstUpper(pk->getName()) };
+    string invalidateObj = invalidateFor(table, "obj.get" + getterName + "()");
+
+    ofs << "void " << myClassName << "::update(pqxx::transaction_base &work, " << baseClassName << " &obj) {"  << endl
+        << "\tif (obj.get" << getterName << "() == 0) {" << endl
+        << "\t\tdoInsert(work, obj);" << endl
+        << "\t}" << endl
+        << "\telse {" << endl
+        << "\t\tdoUpdate(work, obj);" << endl
+           ;
+    if (wantCache) {
+        ofs << "\t\t" << invalidateObj << endl;
+    }
+    ofs << "\t}" << endl
+        << "}" << endl
+        << endl
+           ;
+    generateCPP_WriterWrapper(table, ofs, myClassName, "update", false, invalidateObj);
+
+    //--------------------------------------------------
+    // Write the inserter and updater.
+    //--------------------------------------------------
+    generateCPP_DoInsert(table, ofs, myClassName);
+    if (dirtyTracking) {
+        generateCPP_DirtyUpdate(table, ofs, myClassName);
+    }
+    else {
+        generateCPP_DoUpdate(table, ofs, myClassName);
+    }
+
+    generateCPP_DeleteWithId(table, ofs, myClassName);
+    generateCPP_InsertAll(table, ofs, myClassName);
+    generateCPP_UpdateAll(table, ofs, myClassName);
+    generateCPP_Upserts(table, ofs, myClassName);
+
+    if (usePreparedStatements) {
+        generateCPP_Prepare(table, ofs, myClassName);
+    }
+}
+
+/**
+ * This generates the readAll method, which does the query and then gets the
+ * other methods to parse it.
+ */
+void CodeGenerator_DB::generateCPP_ReadAll(Table &table, std::ostream &ofs, const string &myClassName) {
+    string baseClassName = table.getName();
+    const Column::Pointer pk = table.findPrimaryKey();
+    string pkGetter { string{"get"} + firstUpper(pk->getName()) + "()"};
+
+    ofs << baseClassName << "::Vector " << myClassName << "::readAll(pqxx::transaction_base &work, std::string whereClause) {" << endl
+           ;
+
+    generateCPP_ReadAllQuery(table, ofs);
+
+    ofs << "\t" << baseClassName << "::Vector vec = parseAll(results);" << endl
+        << "\treturn vec;" << endl
+        << "}" << endl
+        << endl
+       ;
+    generateCPP_ConnectionWrapper(ofs, myClassName, baseClassName + "::Vector", "readAll", "std::string whereClause", "whereClause");
+}
+
+/**
+ * The query half of readAll() and its relatives: the SELECT for whereClause into
+ * a pqxx::result named results.
+ */
+void CodeGenerator_DB::generateCPP_ReadAllQuery(Table &table, std::ostream &ofs) {
+    if (usePreparedStatements) {
+        ofs << "\tpqxx::result results = whereClause.length() > 0" << endl
+            << "\t\t? work.exec( string{\"SELECT \"} + QUERY_LIST + \" FROM " << table.getDbName() << " WHERE \" + whereClause )" << endl
+            << "\t\t: work.exec_prepared(\"" << statementName(table, "readAll") << "\");" << endl;
+    }
+    else {
+        ofs << "\tpqxx::result results = work.exec( string{\"SELECT \"} + QUERY_LIST + \" FROM " << table.getDbName()
+                << '"' << " + (whereClause.length() > 0 ? ( string{\" WHERE \"} + whereClause ): \"\""
+                << "));" << endl;
+    }
+}
+
+/**
+ * This generates readEach(), which streams the rows with COPY instead of holding
+ * the entire result set (and then a Vector built from it) in memory. We fill a
+ * single object and hand it to the callback for each row.
+ */
+void CodeGenerator_DB::generateCPP_ReadEach(Table &table, std::ostream &ofs, const string &myClassName) {
+    string baseClassName = table.getName();
+    string callbackType = string{"std::function<void(const "} + baseClassName + " &)>";
+
+    ofs << "void " << myClassName << "::readEach(pqxx::transaction_base &work, std::string whereClause, "
+            << callbackType << " callback) {" << endl
+        << "\tpqxx::stream_from stream { work, pqxx::from_query, string{\"SELECT \"} + QUERY_LIST + \" FROM " << table.getDbName()
+            << '"' << " + (whereClause.length() > 0 ? ( string{\" WHERE \"} + whereClause ): \"\") };" << endl
+        << "\tstd::tuple<";
+
+    string delim;
+    for (const Column::Pointer &column: table.getColumns()) {
+        // COPY can't decode the chrono types, so we take those as text and parse them below.
+        string cType = cTypeFor(column->getDataType());
+        ofs << delim << "std::optional<" << (cType == "string" ? "std::string" : cType) << ">";
+        delim = ", ";
+    }
+
+    ofs << "> row;" << endl
+        << "\t" << baseClassName << " obj;" << endl
+        << endl
+        << "\twhile (stream >> row) {" << endl
+           ;
+
+    int index = 0;
+    for (const Column::Pointer &column: table.getColumns()) {
+        string cType = cTypeFor(column->getDataType());
+        string valueForNull = cType == "string" ? "\"\"" : "0";
+        string timeName = nativeTime ? nativeTimeNameFor(column->getDataType()) : "";
+
+        if (!timeName.empty()) {
+            ofs << "\t\tobj.set" << firstUpper(column->getName())
+                << "( std::get<" << index << ">(row) ? parse" << timeName << "(*std::get<" << index << ">(row)) : "
+                << cTypeFor(*column, nativeTime) << "{} );" << endl;
+        }
+        else {
+            ofs << "\t\tobj.set" << firstUpper(column->getName())
+                << "( std::get<" << index << ">(row).value_or(" << valueForNull << ") );" << endl;
+        }
+
+        ++index;
+    }
+
+    ofs << "\t\tcallback(obj);" << endl
+        << "\t}" << endl
+        << "\tstream.complete();" << endl
+        << "}" << endl
+        << endl
+           ;
+    generateCPP_ConnectionWrapper(ofs, myClassName, "void", "readEach",
+                                  string{"std::string whereClause, "} + callbackType + " callback", "whereClause, callback");
+}
+
+/**
+ * This generates readAllValues(), the Foo_Value form of readAll(). We fill the
+ * structs in place in one vector sized up front.
+ */
+void CodeGenerator_DB::generateCPP_ReadAllValues(Table &table, std::ostream &ofs, const string &myClassName) {
+    string valueClassName = table.getName() + "_Value";
+
+    ofs << valueClassName << "::Vector " << myClassName << "::readAllValues(pqxx::transaction_base &work, std::string whereClause) {" << endl
+           ;
+
+    generateCPP_ReadAllQuery(table, ofs);
+
+    ofs << "\t" << valueClassName << "::Vector vec(results.size());" << endl
+        << "\tsize_t index = 0;" << endl
+        << "\tfor (const pqxx::row &row: results) {" << endl
+        << "\t\t" << valueClassName << " &obj = vec[index++];" << endl
+           ;
+
+    int index = 0;
+    for (const Column::Pointer &column: table.getColumns()) {
+        ofs << "\t\tif (!row[" << index << "].is_null()) {" << endl
+            << "\t\t\tobj." << column->getName() << " = " << fieldValue(*column, index) << ";" << endl
+            << "\t\t}" << endl
+               ;
+        ++index;
+    }
+
+    ofs << "\t}" << endl
+        << "\treturn vec;" << endl
+        << "}" << endl
+        << endl
+           ;
+    generateCPP_ConnectionWrapper(ofs, myClassName, valueClassName + "::Vector", "readAllValues", "std::string whereClause", "whereClause");
+}
+
+/**
+ * This generates readColumns(), which fills a Foo_Columns snapshot. Strings go into
+ * the dictionary straight from the field's buffer.
+ */
+void CodeGenerator_DB::generateCPP_ReadColumns(Table &table, std::ostream &ofs, const string &myClassName) {
+    string columnsClassName = table.getName() + "_Columns";
+
+    ofs << columnsClassName << " " << myClassName << "::readColumns(pqxx::transaction_base &work, std::string whereClause) {" << endl
+           ;
+
+    generateCPP_ReadAllQuery(table, ofs);
+
+    ofs << "\t" << columnsClassName << " columns;" << endl
+        << "\tcolumns.reserve(results.size());" << endl
+        << "\tfor (const pqxx::row &row: results) {" << endl
+           ;
+
+    int index = 0;
+    for (const Column::Pointer &column: table.getColumns()) {
+        string value = dataTypeWantsDictionary(column->getDataType())
+            ? string{"std::string_view{ row["} + std::to_string(index) + "].c_str(), row[" + std::to_string(index) + "].size() }"
+            : fieldValue(*column, index);
+
+        ofs << "\t\tif (row[" << index << "].is_null()) {" << endl
+            << "\t\t\tcolumns." << column->getName() << ".push_null();" << endl
+            << "\t\t}" << endl
+            << "\t\telse {" << endl
+            << "\t\t\tcolumns." << column->getName() << ".push_back(" << value << ");" << endl
+            << "\t\t}" << endl
+               ;
+        ++index;
+    }
+
+    ofs << "\t}" << endl
+        << "\treturn columns;" << endl
+        << "}" << endl
+        << endl
+           ;
+    generateCPP_ConnectionWrapper(ofs, myClassName, columnsClassName, "readColumns", "std::string whereClause", "whereClause");
+}
+
+/**
+ * This generates the readPage_ByXxx methods. These use keyset pagination: rather
+ * than an OFFSET, the caller passes the last value from the previous page, so
+ * every page is an index range scan no matter how deep they go. For columns that
+ * aren't unique, we break ties with the primary key, so the caller passes that, too.
+ */
+void CodeGenerator_DB::generateCPP_ReadPages(Table &table, std::ostream &ofs, const string &myClassName) {
+    string baseClassName = table.getName();
+    const Column::Pointer pk = table.findPrimaryKey();
+
+    for (const Column::Pointer &column: pageColumnsFor(table)) {
+        string methodName = string{"readPage_By"} + firstUpper(column->getName());
+        string params = paramTypeFor(*column) + "after" + firstUpper(column->getName());
+        string args = string{"after"} + firstUpper(column->getName());
+        string queryArgs = argumentFor(*column, args);
+
+        if (column != pk) {
+            params += ", int after" + firstUpper(pk->getName());
+            args += ", after" + firstUpper(pk->getName());
+            queryArgs += ", after" + firstUpper(pk->getName());
+        }
+        params += ", int limit";
+        args += ", limit";
+        queryArgs += ", limit";
+
+        ofs << baseClassName << "::Vector " << myClassName << "::" << methodName
+            << "(pqxx::transaction_base &work, " << params << ") {" << endl
+               ;
+
+        if (usePreparedStatements) {
+            ofs << "\tpqxx::result results = work.exec_prepared(\"" << statementName(table, methodName) << "\", " << queryArgs << ");" << endl;
+        }
+        else {
+            ofs << "\tpqxx::result results = work.exec_params(\"" << pageSqlFor(table, *column) << "\", " << queryArgs << ");" << endl;
+        }
+
+        ofs << "\t" << baseClassName << "::Vector vec = parseAll(results);" << endl
+            << "\treturn vec;" << endl
+            << "}" << endl
+            << endl
+               ;
+        generateCPP_ConnectionWrapper(ofs, myClassName, baseClassName + "::Vector", methodName, params, args);
+    }
+}
+
+/**
+ * This parses the results of a query.
+ */
+void CodeGenerator_DB::generateCPP_ParseAll(Table &table, std::ostream &ofs, const string &myClassName) {
+    string baseClassName = table.getName();
+    const Column::Pointer pk = table.findPrimaryKey();
+    string pkGetter { string{"get"} + firstUpper(pk->getName()) + "()"};
+
+    ofs << baseClassName << "::Vector " << myClassName << "::parseAll(pqxx::result &results) {" << endl
+        << "\t" << baseClassName << "::Vector vec;" << endl
+        << "\tfor (pqxx::row row: results) {" << endl
+        << "\t\tvec.push_back(parseOne(row));" << endl
+        << "\t}" << endl
+        << "\treturn vec;" << endl
+        << "}" << endl
+        << endl
+       ;
+}
+
+/**
+ * This parses the results of one row.
+ */
+void CodeGenerator_DB::generateCPP_ParseOne(Table &table, std::ostream &ofs, const string &myClassName) {
+    string baseClassName = table.getName();
+    const Column::Pointer pk = table.findPrimaryKey();
+    string pkGetter { string{"get"} + firstUpper(pk->getName()) + "()"};
+
+    ofs << baseClassName << "::Pointer " << myClassName << "::parseOne(pqxx::row &row) {" << endl
+        << "\t" << baseClassName << "::Pointer ptr = std::make_shared<" << baseClassName << ">();" << endl
+           ;
+
+    int index = 0;
+    for (const Column::Pointer &column: table.getColumns()) {
+        string cType = cTypeFor(*column, nativeTime);
+        string stringForNull;
+
+        if (cType == "string") {
+            stringForNull = "\"\"";
+        }
+        else if (nativeTime && !nativeTimeNameFor(column->getDataType()).empty()) {
+            stringForNull = cType + "{}";
+        }
+        else {
+            stringForNull = "0";
+        }
+
+        ofs << "\tptr->set" << firstUpper(column->getName())
+            << "( row[" << index << "].is_null() ? " << stringForNull << " : " << fieldValue(*column, index) << " );" << endl;
+               ;
+
+        ++index;
+    }
+
+    if (dirtyTracking) {
+        ofs << "\tptr->markClean();" << endl;
+    }
+
+    ofs << "\treturn ptr;" << endl
+        << "}" << endl
+        << endl
+       ;
+}
+
+/**
+ * This generates any readers based on having FK relationships.
+ */
+void
+CodeGenerator_DB::generateCPP_FromForeignKeys(Table &table, std::ostream &ofs, const string &myClassName) {
+    string baseClassName = table.getName();
+
+    for (const Column::Pointer &column: table.getColumns()) {
+        Column::Pointer fk = column->getReferences();
+        if (fk != nullptr) {
+            string refPtrName = refPtrNameFor(*column);
+
+            ofs << baseClassName << "::Vector " << myClassName << "::readAll_For" << refPtrName
+                << "(pqxx::transaction_base &work, int " << column->getName() << ") {"  << endl
+                   ;
+
+            if (usePreparedStatements) {
+                ofs << "\tpqxx::result results = work.exec_prepared(\""
+                    << statementName(table, "readAll_For" + refPtrName) << "\", " << column->getName() << ");" << endl;
+            }
+            else {
+                ofs << "\tpqxx::result results = work.exec( string{\"SELECT \"} + QUERY_LIST + \" FROM " << table.getDbName()
+                    << " WHERE " << column->getDbName() << " = \" + std::to_string(" << column->getName() << "));" << endl;
+            }
+
+            ofs << "\t" << baseClassName << "::Vector vec = parseAll(results);" << endl
+                << "\treturn vec;" << endl
+               ;
+            ofs << "}" << endl << endl;
+            generateCPP_ConnectionWrapper(ofs, myClassName, baseClassName + "::Vector", "readAll_For" + refPtrName,
+                                          "int " + column->getName(), column->getName());
+
+            //--------------------------------------------------
+            // And for many parents at once, grouped by parent.
+            //--------------------------------------------------
+            string mapType = string{"std::unordered_map<int, "} + baseClassName + "::Vector>";
+
+            ofs << mapType << " " << myClassName << "::readAll_For" << refPtrName
+                    << "(pqxx::transaction_base &work, const std::vector<int> &ids) {"  << endl
+                << "\tpqxx::result results = work.exec_params( string{\"SELECT \"} + QUERY_LIST + \" FROM " << table.getDbName()
+                    << " WHERE " << column->getDbName() << " = ANY($1)\", toArrayLiteral(ids));" << endl
+                << "\t" << mapType << " map;" << endl
+                << "\tfor (pqxx::row row: results) {" << endl
+                << "\t\t" << baseClassName << "::Pointer ptr = parseOne(row);" << endl
+                << "\t\tmap[ptr->get" << firstUpper(column->getName()) << "()].push_back(ptr);" << endl
+                << "\t}" << endl
+                << "\treturn map;" << endl
+                << "}" << endl
+                << endl
+                   ;
+            generateCPP_ConnectionWrapper(ofs, myClassName, mapType, "readAll_For" + refPtrName,
+                                          "const std::vector<int> &ids", "ids");
+        }
+    }
+}
+
+/**
+ * This generates readers based on map tables, which
+ * a join, and is complicated to write, even though the SQL
+ * really is pretty trivial.
+ */
+void
+CodeGenerator_DB::generateCPP_FromMapFiles(Table &table, std::ostream &ofs, const string &myClassName) {
+    for (const Table::Pointer &thisTable: mapTablesFor(table)) {
+        generateCPP_ThisMap(table, ofs, *thisTable, myClassName);
+    }
+}
+
+/**
+ * Generates a join.
+ *
+ *    SELECT foo.* FROM foo, bar WHERE foo.id = bar.foo_id AND bar.gleep_id = 10
+ */
+void
+CodeGenerator_DB::generateCPP_ThisMap(
+    Table &table,			// The table we're returning
+    std::ostream &ofs,					// Output stream
+    Table &mapTable,			// The mapping table
+    const std::string &myClassName)
+{
+    string baseClassName = table.getName();
+    Column::Pointer colToUs = mapTable.ourMapTableReference(table);
+    Column::Pointer ourKeyColumn = colToUs->getReferences();
+
+    Column::Pointer colToThem = mapTable.otherMapTableReference(table);
+
+    ofs << baseClassName << "::Vector " << myClassName << "::readAll_FromMap_"
+        << mapTable.getName() << "(pqxx::transaction_base &work, int " << colToThem->getName() << ") {"  << endl
+           ;
+
+    if (usePreparedStatements) {
+        ofs << "\tpqxx::result results = work.exec_prepared(\""
+            << statementName(table, "readAll_FromMap_" + mapTable.getName()) << "\", " << colToThem->getName() << ");" << endl;
+    }
+    else {
+        ofs << "\tpqxx::result results = work.exec( string{\"SELECT \"} + QUALIFIED_QUERY_LIST + \" FROM "
+            << table.getDbName() << ", " << mapTable.getDbName()
+
+            // This is the join to us
+            << " WHERE " << table.getDbName() << "." << ourKeyColumn->getDbName() << " = "
+            << mapTable.getDbName() << "." << colToUs->getDbName()
+
+            // And this is the join from the distant table, which is from the method's argument list
+            << " AND " << mapTable.getDbName() << "." << colToThem->getDbName() << " = "
+            << "\" + std::to_string(" << colToThem->getName() << "));" << endl;
+    }
+
+    ofs << "\t" << baseClassName << "::Vector vec = parseAll(results);" << endl
+        << "\treturn vec;" << endl
+       ;
+    ofs << "}" << endl << endl;
+    generateCPP_ConnectionWrapper(ofs, myClassName, baseClassName + "::Vector", "readAll_FromMap_" + mapTable.getName(),
+                                  "int " + colToThem->getName(), colToThem->getName());
+
+    //--------------------------------------------------
+    // The batched form. We also select the map table's key to the distant
+    // table, after our own columns, so we know which group a row goes in.
+    //--------------------------------------------------
+    string mapType = string{"std::unordered_map<int, "} + baseClassName + "::Vector>";
+    string groupColumn = mapTable.getDbName() + "." + colToThem->getDbName();
+    string groupSql = mapJoinSqlFor(table, mapTable) + "ANY($1)";
+    groupSql.replace(groupSql.find(" FROM "), 0, ", " + groupColumn);
+
+    ofs << mapType << " " << myClassName << "::readAll_FromMap_"
+            << mapTable.getName() << "(pqxx::transaction_base &work, const std::vector<int> &ids) {"  << endl
+        << "\tpqxx::result results = work.exec_params(\"" << groupSql << "\", toArrayLiteral(ids));" << endl
+        << "\t" << mapType << " map;" << endl
+        << "\tfor (pqxx::row row: results) {" << endl
+        << "\t\tmap[row[" << table.getColumns().size() << "].as<int>()].push_back(parseOne(row));" << endl
+        << "\t}" << endl
+        << "\treturn map;" << endl
+        << "}" << endl
+        << endl
+           ;
+    generateCPP_ConnectionWrapper(ofs, myClassName, mapType, "readAll_FromMap_" + mapTable.getName(),
+                                  "const std::vector<int> &ids", "ids");
+}
+
+/**
+ * This writes the pipelined readers. A pqxx::pipeline only takes plain query text,
+ * so the keys go into the SQL, the way the unprepared readers do it.
+ */
+void
+CodeGenerator_DB::generateCPP_QueueReaders(Table &table, std::ostream &ofs, const string &myClassName) {
+    string baseClassName = table.getName();
+
+    ofs << "pqxx::pipeline::query_id " << myClassName << "::queueReadAll(pqxx::pipeline &pipeline, std::string whereClause) {" << endl
+        << "\treturn pipeline.insert( string{\"SELECT \"} + QUERY_LIST + \" FROM " << table.getDbName()
+            << '"' << " + (whereClause.length() > 0 ? ( string{\" WHERE \"} + whereClause ): \"\"));" << endl
+        << "}" << endl
+        << endl
+           ;
+
+    for (const Column::Pointer &column: table.getColumns()) {
+        if (column->getReferences() != nullptr) {
+            ofs << "pqxx::pipeline::query_id " << myClassName << "::queueReadAll_For" << refPtrNameFor(*column)
+                    << "(pqxx::pipeline &pipeline, int " << column->getName() << ") {" << endl
+                << "\treturn pipeline.insert( string{\"SELECT \"} + QUERY_LIST + \" FROM " << table.getDbName()
+                    << " WHERE " << column->getDbName() << " = \" + std::to_string(" << column->getName() << "));" << endl
+                << "}" << endl
+                << endl
+                   ;
+        }
+    }
+
+    for (const Table::Pointer &mapTable: mapTablesFor(table)) {
+        Column::Pointer colToThem = mapTable->otherMapTableReference(table);
+
+        ofs << "pqxx::pipeline::query_id " << myClassName << "::queueReadAll_FromMap_" << mapTable->getName()
+                << "(pqxx::pipeline &pipeline, int " << colToThem->getName() << ") {" << endl
+            << "\treturn pipeline.insert( string{\"" << mapJoinSqlFor(table, *mapTable) << "\"} + std::to_string("
+                << colToThem->getName() << "));" << endl
+            << "}" << endl
+            << endl
+               ;
+    }
+
+    ofs << baseClassName << "::Vector " << myClassName << "::collect(pqxx::pipeline &pipeline, pqxx::pipeline::query_id id) {" << endl
+        << "\tpqxx::result results = pipeline.retrieve(id);" << endl
+        << "\treturn parseAll(results);" << endl
+        << "}" << endl
+        << endl
+           ;
+}
+
+/**
+ * This writes readGraph() and loadChildren(), plus the readAll_ForAnyXxx() readers
+ * they use. A level of children costs one round trip: we queue one
+ * fk = ANY(ids) query for each table that points at us, then link the rows in
+ * memory with the hash join in Utilities.
+ */
+void
+CodeGenerator_DB::generateCPP_ReadGraph(Table &table, std::ostream &ofs, const string &myClassName) {
+    string baseClassName = table.getName();
+    const Column::Pointer pk = table.findPrimaryKey();
+    string pkGetter { string{"get"} + firstUpper(pk->getName()) + "()"};
+
+    //--------------------------------------------------
+    // Readers for our rows that point at any of a set of parents.
+    //--------------------------------------------------
+    for (const Table::Pointer &parent: parentTablesFor(table)) {
+        string methodName = string{"readAll_ForAny"} + parent->getName();
+        string where;
+        string literalWhere;
+        for (const Column::Pointer &column: model.getRelationships().referencesFrom(table, *parent)) {
+            where += (where.empty() ? "" : " OR ") + column->getDbName() + " = ANY($1)";
+            literalWhere += (literalWhere.empty() ? "" : " OR ") + column->getDbName() + " = ANY('\" + ids + \"')";
+        }
+
+        ofs << baseClassName << "::Vector " << myClassName << "::" << methodName
+                << "(pqxx::transaction_base &work, const std::vector<int> &ids) {" << endl
+            << "\tpqxx::result results = work.exec_params( string{\"SELECT \"} + QUERY_LIST + \" FROM " << table.getDbName()
+                << " WHERE " << where << "\", toArrayLiteral(ids));" << endl
+            << "\treturn parseAll(results);" << endl
+            << "}" << endl
+            << endl
+               ;
+        generateCPP_ConnectionWrapper(ofs, myClassName, baseClassName + "::Vector", methodName, "const std::vector<int> &ids", "ids");
+
+        ofs << "pqxx::pipeline::query_id " << myClassName << "::queue" << firstUpper(methodName)
+                << "(pqxx::pipeline &pipeline, const std::vector<int> &idVec) {" << endl
+            << "\tstring ids = toArrayLiteral(idVec);" << endl
+            << "\treturn pipeline.insert( string{\"SELECT \"} + QUERY_LIST + \" FROM " << table.getDbName()
+                << " WHERE " << literalWhere << "\");" << endl
+            << "}" << endl
+            << endl
+               ;
+    }
+
+    //--------------------------------------------------
+    // readGraph() and loadChildren().
+    //--------------------------------------------------
+    ofs << baseClassName << "::Vector " << myClassName << "::readGraph(pqxx::transaction_base &work, std::string whereClause, int depth) {" << endl
+        << "\t" << baseClassName << "::Vector vec = readAll(work, whereClause);" << endl
+        << "\tloadChildren(work, vec, depth);" << endl
+        << "\treturn vec;" << endl
+        << "}" << endl
+        << endl
+           ;
+    generateCPP_ConnectionWrapper(ofs, myClassName, baseClassName + "::Vector", "readGraph",
+                                  "std::string whereClause, int depth", "whereClause, depth");
+
+    std::vector<Table::Pointer> children = childTablesFor(table);
+
+    ofs << "void " << myClassName << "::loadChildren(pqxx::transaction_base &"
+            << (children.empty() ? "" : "work") << ", " << baseClassName << "::Vector &"
+            << (children.empty() ? "" : "vec") << ", int" << (children.empty() ? "" : " depth") << ") {" << endl
+           ;
+
+    if (children.empty()) {
+        ofs << "}" << endl << endl;
+        return;
+    }
+
+    ofs << "\tif (depth <= 0 || vec.empty()) {" << endl
+        << "\t\treturn;" << endl
+        << "\t}" << endl
+        << endl
+        << "\tstd::vector<int> ids;" << endl
+        << "\tids.reserve(vec.size());" << endl
+        << "\tfor (const " << baseClassName << "::Pointer &ptr: vec) {" << endl
+        << "\t\tids.push_back(ptr->" << pkGetter << ");" << endl
+        << "\t}" << endl
+        << endl
+           ;
+
+    for (const Table::Pointer &child: children) {
+        ofs << "\t" << child->getName() << "::Vector " << firstLower(child->getName()) << "Rows;" << endl;
+    }
+
+    ofs << "\t{" << endl
+        << "\t\tpqxx::pipeline pipeline {work};" << endl
+           ;
+    for (const Table::Pointer &child: children) {
+        ofs << "\t\tpqxx::pipeline::query_id " << firstLower(child->getName()) << "Query = DB_" << child->getName()
+                << "_Base::queueReadAll_ForAny" << baseClassName << "(pipeline, ids);" << endl;
+    }
+    for (const Table::Pointer &child: children) {
+        ofs << "\t\t" << firstLower(child->getName()) << "Rows = DB_" << child->getName()
+                << "_Base::collect(pipeline, " << firstLower(child->getName()) << "Query);" << endl;
+    }
+    ofs << "\t\tpipeline.complete();" << endl
+        << "\t}" << endl
+        << endl
+           ;
+
+    for (const Table::Pointer &child: children) {
+        ofs << "\tresolveReferences(" << firstLower(child->getName()) << "Rows, vec);" << endl;
+    }
+    for (const Table::Pointer &child: children) {
+        ofs << "\tDB_" << child->getName() << "_Base::loadChildren(work, " << firstLower(child->getName()) << "Rows, depth - 1);" << endl;
+    }
+
+    ofs << "}" << endl
+        << endl
+           ;
+}
+
+/**
+ * This writes the doInsert method.
+ */
+void CodeGenerator_DB::generateCPP_DoInsert(Table &table, std::ostream &ofs, const string &myClassName) {
+    string baseClassName = table.getName();
+    const Column::Pointer pk = table.findPrimaryKey();
+    string pkGetter { string{"get"} + firstUpper(pk->getName()) + "()"};
+
+    ofs << "void " << myClassName << "::doInsert(pqxx::transaction_base &work, " << baseClassName << " &obj) {"  << endl
+           ;
+
+    if (usePreparedStatements) {
+        ofs << "\tpqxx::result results = work.exec_prepared(\"" << statementName(table, "insert") << "\"";
+        generateCPP_FieldArguments(table, ofs);
+        ofs << ");" << endl
+            << "\tobj.set" << firstUpper(pk->getName()) << "(results[0][0].as<int>()" << ");" << endl
+               ;
+        if (dirtyTracking) {
+            ofs << "\tobj.markClean();" << endl;
+        }
+        ofs << "}" << endl
+            << endl
+               ;
+        return;
+    }
+
+    ofs << "\tstring sql { string{\"INSERT INTO " << table.getDbName()
+            << " (\"} + INSERT_LIST + \")"
+            << " VALUES ("
+               ;
+
+    generateCPP_ParameterList(table, ofs, false, 1);
+
+    ofs << ") RETURNING " << pk->getDbName() << "\" };" << endl
+        << "\tpqxx::result results = work.exec_params(sql";
+
+    generateCPP_FieldArguments(table, ofs);
+
+    ofs << ");" << endl
+        << "\tobj.set" << firstUpper(pk->getName()) << "(results[0][0].as<int>()" << ");" << endl
+           ;
+    if (dirtyTracking) {
+        ofs << "\tobj.markClean();" << endl;
+    }
+    ofs << "}" << endl
+        << endl
+           ;
+}
+
+
+/**
+ * This writes the doUpdate() method, which is similar to the doInsert() method,
+ * but of course, SQL UPDATE statements aren't identical to INSERT statements.
+ */
+void CodeGenerator_DB::generateCPP_DoUpdate(Table &table, std::ostream &ofs, const string &myClassName) {
+    string baseClassName = table.getName();
+    const Column::Pointer pk = table.findPrimaryKey();
+    string pkGetter { string{"get"} + firstUpper(pk->getName()) + "()"};
+
+    ofs << "void " << myClassName << "::doUpdate(pqxx::transaction_base &work, " << baseClassName << " &obj) {"  << endl
+           ;
+
+    if (usePreparedStatements) {
+        ofs << "\tpqxx::result results = work.exec_prepared(\"" << statementName(table, "update") << "\", obj." << pkGetter;
+        generateCPP_FieldArguments(table, ofs);
+        ofs << ");" << endl
+            << "}" << endl
+            << endl
+               ;
+        return;
+    }
+
+    ofs << "\tstring sql { \"UPDATE " << table.getDbName() << " SET "
+           ;
+
+    generateCPP_ParameterList(table, ofs, true, 2);
+
+    ofs << " WHERE " << pk->getDbName() << " = $1\" };" << endl
+        << "\tpqxx::result results = work.exec_params(sql, obj." << pkGetter
+           ;
+
+    generateCPP_FieldArguments(table, ofs);
+
+    ofs << ");" << endl
+        << "}" << endl
+        << endl
+           ;
+}
+
+/**
+ * With dirtyTracking, this writes a doUpdate() that sends only the columns whose
+ * setters changed them, and skips the round trip when none did. There's a different
+ * UPDATE for each combination of columns, so updateSqlFor() builds each one on first
+ * use and keeps it. They run with exec_params(). With preparedStatements, an update
+ * of every column still uses the prepared statement.
+ */
+void CodeGenerator_DB::generateCPP_DirtyUpdate(Table &table, std::ostream &ofs, const string &myClassName) {
+    string baseClassName = table.getName();
+    const Column::Pointer pk = table.findPrimaryKey();
+    string pkGetter { string{"get"} + firstUpper(pk->getName()) + "()"};
+
+    //--------------------------------------------------
+    // updateSqlFor(). Each column's SET fragment is split around its parameter number.
+    //--------------------------------------------------
+    string prefixes;
+    string suffixes;
+    for (const Column::Pointer &column: table.getColumns()) {
+        if (column->getIsPrimaryKey()) {
+            prefixes += "\t\t\"\",\n";
+            suffixes += "\t\t\"\",\n";
+            continue;
+        }
+        auto [prefix, suffix] = parameterWrapperFor(*column);
+        prefixes += "\t\t\"" + column->getDbName() + " = " + prefix + "\",\n";
+        suffixes += "\t\t\"" + suffix + "\",\n";
+    }
+
+    ofs << "const std::string & " << myClassName << "::updateSqlFor(const " << baseClassName << "::DirtyColumns &dirty) {" << endl
+        << "\tstatic const char * const prefixes[] = {" << endl
+        << prefixes
+        << "\t};" << endl
+        << "\tstatic const char * const suffixes[] = {" << endl
+        << suffixes
+        << "\t};" << endl
+        << "\tstatic std::mutex cacheMutex;" << endl
+        << "\tstatic std::unordered_map<" << baseClassName << "::DirtyColumns, string> cache;" << endl
+        << endl
+        << "\tstd::lock_guard<std::mutex> lock { cacheMutex };" << endl
+        << "\tstring &sql = cache[dirty];" << endl
+        << "\tif (sql.empty()) {" << endl
+        << "\t\tint paramNumber = 1;" << endl
+        << "\t\tsql = \"UPDATE " << table.getDbName() << " SET \";" << endl
+        << "\t\tfor (size_t index = 0; index < dirty.size(); ++index) {" << endl
+        << "\t\t\tif (dirty.test(index)) {" << endl
+        << "\t\t\t\tsql += paramNumber > 1 ? \", \" : \"\";" << endl
+        << "\t\t\t\tsql += prefixes[index] + std::to_string(++paramNumber) + suffixes[index];" << endl
+        << "\t\t\t}" << endl
+        << "\t\t}" << endl
+        << "\t\tsql += \" WHERE " << pk->getDbName() << " = $1\";" << endl
+        << "\t}" << endl
+        << "\treturn sql;" << endl
+        << "}" << endl
+        << endl
+           ;
+
+    //--------------------------------------------------
+    // doUpdate().
+    //--------------------------------------------------
+    size_t pkIndex = 0;
+    size_t otherCount = 0;
+    for (size_t index = 0; index < table.getColumns().size(); ++index) {
+        if (table.getColumns()[index]->getIsPrimaryKey()) {
+            pkIndex = index;
+        }
+        else {
+            ++otherCount;
+        }
+    }
+
+    ofs << "void " << myClassName << "::doUpdate(pqxx::transaction_base &work, " << baseClassName << " &obj) {"  << endl
+        << "\t" << baseClassName << "::DirtyColumns dirty = obj.getDirtyColumns();" << endl
+        << "\tdirty.reset(" << pkIndex << ");" << endl
+        << "\tif (dirty.none()) {" << endl
+        << "\t\treturn;" << endl
+        << "\t}" << endl
+        << endl
+           ;
+
+    if (usePreparedStatements) {
+        ofs << "\tif (dirty.count() == " << otherCount << ") {" << endl
+            << "\t\twork.exec_prepared(\"" << statementName(table, "update") << "\", obj." << pkGetter;
+        generateCPP_FieldArguments(table, ofs);
+        ofs << ");" << endl
+            << "\t\tobj.markClean();" << endl
+            << "\t\treturn;" << endl
+            << "\t}" << endl
+            << endl
+               ;
+    }
+
+    ofs << "\tpqxx::params params;" << endl
+        << "\tparams.append(obj." << pkGetter << ");" << endl
+           ;
+
+    for (size_t index = 0; index < table.getColumns().size(); ++index) {
+        Column &column = *table.getColumns()[index];
+        if (!column.getIsPrimaryKey()) {
+            string getterStr = string{"obj.get"} + firstUpper(column.getName()) + "()";
+            ofs << "\tif (dirty.test(" << index << ")) {" << endl
+                << "\t\tparams.append(" << argumentFor(column, getterStr) << ");" << endl
+                << "\t}" << endl
+                   ;
+        }
+    }
+
+    ofs << "\twork.exec_params(updateSqlFor(dirty), params);" << endl
+        << "\tobj.markClean();" << endl
+        << "}" << endl
+        << endl
+           ;
+}
+
+/**
+ * We're building an INSERT or UPDATE statement. This is the VALUES portion, which
+ * will be a bunch of $1, $2, nullif($3,0), etc.
+ */
+void
+CodeGenerator_DB::generateCPP_ParameterList(DataModel::Table &table, std::ostream &ofs, bool forUpdate, int startIndex) {
+    string delim {""};
+    for (const Column::Pointer &column: table.getColumns()) {
+        if (!column->getIsPrimaryKey()) {
+            ofs << delim;
+
+            if (forUpdate) {
+                ofs << column->getDbName() << " = ";
+            }
+            auto [prefix, suffix] = parameterWrapperFor(*column);
+            ofs << prefix << startIndex << suffix;
+            delim = ", ";
+            ++startIndex;
+        }
+    }
+}
+
+/**
+ * This is used to do the latter part of work.exec_params(). We have to handle
+ * nulls / empty strings, 0s in foreign keys.
+ */
+void
+CodeGenerator_DB::generateCPP_FieldArguments(DataModel::Table &table, std::ostream &ofs) {
+    for (const Column::Pointer &column: table.getColumns()) {
+        if (!column->getIsPrimaryKey()) {
+            string getterStr = string{"obj.get"} + firstUpper(column->getName()) + "()";
+            ofs << ",\n\t\t";
+            ofs << argumentFor(*column, getterStr);
+        }
+    }
+}
+
+/**
+ * This is the COPY version of generateCPP_FieldArguments(). COPY can't apply
+ * nullif(), so we wrap the values the same way before they go out.
+ */
+void
+CodeGenerator_DB::generateCPP_CopyArguments(DataModel::Table &table, std::ostream &ofs) {
+    for (const Column::Pointer &column: table.getColumns()) {
+        if (!column->getIsPrimaryKey()) {
+            string getterStr = string{"obj.get"} + firstUpper(column->getName()) + "()";
+            ofs << ",\n\t\t\t";
+
+            if (column->isString() || column->isTimestamp() || column->isDate()) {
+                ofs << "nullIfEmpty(" << argumentFor(*column, getterStr) << ")";
+            }
+            else if (column->isForeignKey()) {
+                ofs << "nullIfZero(" << getterStr << ")";
+            }
+            else {
+                ofs << getterStr;
+            }
+        }
+    }
+}
+
+/**
+ * This writes deleteWithId().
+ */
+void CodeGenerator_DB::generateCPP_DeleteWithId(Table &table, std::ostream &ofs, const string &myClassName) {
+    string baseClassName = table.getName();
+    const Column::Pointer pk = table.findPrimaryKey();
+    string pkGetter { string{"get"} + firstUpper(pk->getName()) + "()"};
+
+    ofs << "void " << myClassName << "::deleteWithId(pqxx::transaction_base &work, int id) {"  << endl
+           ;
+
+    if (usePreparedStatements) {
+        ofs << "\twork.exec_prepared(\"" << statementName(table, "delete") << "\", id);" << endl;
+    }
+    else {
+        ofs << "\twork.exec_params(\"DELETE FROM " << table.getDbName() << " WHERE " << pk->getDbName() << " = $1\", id);" << endl;
+    }
+    if (wantCache) {
+        ofs << "\t" << invalidateFor(table, "id") << endl;
+    }
+
+    ofs << "}" << endl
+        << endl
+           ;
+    generateCPP_ConnectionWrapper(ofs, myClassName, "void", "deleteWithId", "int id", "id", invalidateFor(table, "id"));
+}
+
+/**
+ * This writes insertAll(), which streams every row through COPY instead of doing
+ * an INSERT per row. COPY can't hand back generated keys, so we reserve them from
+ * the primary key's sequence first, in one query, and send them with the rows.
+ */
+void CodeGenerator_DB::generateCPP_InsertAll(Table &table, std::ostream &ofs, const string &myClassName) {
+    string baseClassName = table.getName();
+    const Column::Pointer pk = table.findPrimaryKey();
+    string pkGetter { string{"get"} + firstUpper(pk->getName()) + "()"};
+
+    ofs << "void " << myClassName << "::insertAll(pqxx::transaction_base &work, " << baseClassName << "::Vector &vec) {" << endl
+        << "\tif (vec.empty()) {" << endl
+        << "\t\treturn;" << endl
+        << "\t}" << endl
+        << endl
+        << "\tint newCount = 0;" << endl
+        << "\tfor (const " << baseClassName << "::Pointer &ptr: vec) {" << endl
+        << "\t\tif (ptr->" << pkGetter << " == 0) {" << endl
+        << "\t\t\t++newCount;" << endl
+        << "\t\t}" << endl
+        << "\t}" << endl
+        << endl
+        << "\tpqxx::result keys;" << endl
+        << "\tif (newCount > 0) {" << endl
+        << "\t\tkeys = work.exec_params(\"" << reserveKeysSqlFor(table) << "\", newCount);" << endl
+        << "\t}" << endl
+        << endl
+        << "\tstd::vector<int> ids;" << endl
+        << "\tids.reserve(vec.size());" << endl
+        << "\tint keyIndex = 0;" << endl
+        << "\tfor (const " << baseClassName << "::Pointer &ptr: vec) {" << endl
+        << "\t\tids.push_back(ptr->" << pkGetter << " != 0 ? ptr->" << pkGetter << " : keys[keyIndex++][0].as<int>());" << endl
+        << "\t}" << endl
+        << endl
+        << "\tpqxx::stream_to stream { work, \"" << table.getDbName() << "\", std::vector<std::string>{ ";
+
+    // The key goes first, wherever it sits in the table, to match the tuples below.
+    ofs << '"' << pk->getDbName() << '"';
+    for (const Column::Pointer &column: table.getColumns()) {
+        if (!column->getIsPrimaryKey()) {
+            ofs << ", \"" << column->getDbName() << '"';
+        }
+    }
+
+    ofs << " } };" << endl
+        << "\tfor (size_t index = 0; index < vec.size(); ++index) {" << endl
+        << "\t\tconst " << baseClassName << " &obj = *vec[index];" << endl
+        << "\t\tstream << std::make_tuple(ids[index]";
+
+    generateCPP_CopyArguments(table, ofs);
+
+    ofs << ");" << endl
+        << "\t}" << endl
+        << "\tstream.complete();" << endl
+        << endl
+        << "\tfor (size_t index = 0; index < vec.size(); ++index) {" << endl
+        << "\t\tvec[index]->set" << firstUpper(pk->getName()) << "(ids[index]);" << endl
+        << "\t}" << endl
+        << "}" << endl
+        << endl
+           ;
+
+    generateCPP_WriterWrapper(table, ofs, myClassName, "insertAll", true);
+}
+
+/**
+ * The body of the row loop in a multi-row INSERT: one more (...) on the VALUES list,
+ * with the same nullif() handling as doInsert(), and its values appended to params.
+ * If keyExpression isn't empty, the row starts with the primary key it gives.
+ */
+void CodeGenerator_DB::generateCPP_InsertRowValues(Table &table, std::ostream &ofs, const string &keyExpression) {
+    ofs << "\t\t\tsql += index == start ? \"(\" : \", (\";" << endl;
+
+    string delim;
+    if (!keyExpression.empty()) {
+        ofs << "\t\t\tsql += \"$\" + std::to_string(++paramNumber);" << endl;
+        delim = ", ";
+    }
+    for (const Column::Pointer &column: table.getColumns()) {
+        if (column->getIsPrimaryKey()) {
+            continue;
+        }
+
+        if (column->isString() || column->isTimestamp()) {
+            ofs << "\t\t\tsql += \"" << delim << "nullif($\" + std::to_string(++paramNumber) + \", '')\";" << endl;
+        }
+        else if (column->isDate()) {
+            ofs << "\t\t\tsql += \"" << delim << "date(nullif($\" + std::to_string(++paramNumber) + \", ''))\";" << endl;
+        }
+        else if (column->isForeignKey()) {
+            ofs << "\t\t\tsql += \"" << delim << "nullif($\" + std::to_string(++paramNumber) + \", 0)\";" << endl;
+        }
+        else {
+            ofs << "\t\t\tsql += \"" << delim << "$\" + std::to_string(++paramNumber);" << endl;
+        }
+        delim = ", ";
+    }
+
+    ofs << "\t\t\tsql += \")\";" << endl
+           ;
+
+    if (!keyExpression.empty()) {
+        ofs << "\t\t\tparams.append(" << keyExpression << ");" << endl;
+    }
+    for (const Column::Pointer &column: table.getColumns()) {
+        if (!column->getIsPrimaryKey()) {
+            string getterStr = string{"obj.get"} + firstUpper(column->getName()) + "()";
+            ofs << "\t\t\tparams.append(" << argumentFor(*column, getterStr) << ");" << endl;
+        }
+    }
+}
+
+/**
+ * This writes updateAll(). New rows (PK of 0) go out in multi-row INSERTs, and the
+ * rest in one UPDATE ... FROM (VALUES ...) per chunk, so a vector costs a few round
+ * trips instead of one per row. RETURNING doesn't promise to keep the order of the
+ * VALUES list, so as in insertAll() we reserve each chunk's keys and send them.
+ */
+void CodeGenerator_DB::generateCPP_UpdateAll(Table &table, std::ostream &ofs, const string &myClassName) {
+    string baseClassName = table.getName();
+    const Column::Pointer pk = table.findPrimaryKey();
+    string pkGetter { string{"get"} + firstUpper(pk->getName()) + "()"};
+
+    ofs << "void " << myClassName << "::updateAll(pqxx::transaction_base &work, " << baseClassName << "::Vector &vec) {" << endl
+        << "\tstd::vector<" << baseClassName << " *> inserts;" << endl
+        << "\tstd::vector<" << baseClassName << " *> updates;" << endl
+        << "\tfor (const " << baseClassName << "::Pointer &ptr: vec) {" << endl
+           ;
+
+    if (dirtyTracking) {
+        ofs << "\t\tif (ptr->" << pkGetter << " == 0) {" << endl
+            << "\t\t\tinserts.push_back(ptr.get());" << endl
+            << "\t\t}" << endl
+            << "\t\telse if (ptr->isDirty()) {" << endl
+            << "\t\t\tupdates.push_back(ptr.get());" << endl
+            << "\t\t}" << endl
+               ;
+    }
+    else {
+        ofs << "\t\t(ptr->" << pkGetter << " == 0 ? inserts : updates).push_back(ptr.get());" << endl;
+    }
+
+    ofs << "\t}" << endl
+        << endl
+        << "\tconst size_t insertChunkSize = " << chunkSizeFor(table, insertChunkSize) << ";" << endl
+        << "\tfor (size_t start = 0; start < inserts.size(); start += insertChunkSize) {" << endl
+        << "\t\tsize_t end = std::min(inserts.size(), start + insertChunkSize);" << endl
+        << "\t\tpqxx::result keys = work.exec_params(\"" << reserveKeysSqlFor(table) << "\", static_cast<int>(end - start));" << endl
+        << "\t\tstring sql { string{\"INSERT INTO " << table.getDbName() << " (" << pk->getDbName()
+            << ", \"} + INSERT_LIST + \") VALUES \" };" << endl
+        << "\t\tpqxx::params params;" << endl
+        << "\t\tint paramNumber = 0;" << endl
+        << endl
+        << "\t\tfor (size_t index = start; index < end; ++index) {" << endl
+        << "\t\t\tconst " << baseClassName << " &obj = *inserts[index];" << endl
+           ;
+
+    generateCPP_InsertRowValues(table, ofs, "keys[index - start][0].as<int>()");
+
+    ofs << "\t\t}" << endl
+        << endl
+        << "\t\twork.exec_params(sql, params);" << endl
+        << "\t\tfor (size_t index = start; index < end; ++index) {" << endl
+        << "\t\t\tinserts[index]->set" << firstUpper(pk->getName()) << "(keys[index - start][0].as<int>());" << endl
+           ;
+    if (dirtyTracking) {
+        ofs << "\t\t\tinserts[index]->markClean();" << endl;
+    }
+    ofs << "\t\t}" << endl
+        << "\t}" << endl
+        << endl
+           ;
+
+    //--------------------------------------------------
+    // Updates. VALUES has no column types of its own, so we cast the
+    // non-text parameters, and apply the usual nullif() in the SET.
+    //--------------------------------------------------
+    string setList;
+    string aliasList = pk->getDbName();
+    string delim;
+    for (const Column::Pointer &column: table.getColumns()) {
+        if (column->getIsPrimaryKey()) {
+            continue;
+        }
+        string value = string{"batch."} + column->getDbName();
+
+        setList += delim + column->getDbName() + " = ";
+        if (column->isString()) {
+            setList += "nullif(" + value + ", '')";
+        }
+        else if (column->isTimestamp()) {
+            setList += "nullif(" + value + ", '')::" + sqlTypeFor(*column);
+        }
+        else if (column->isDate()) {
+            setList += "date(nullif(" + value + ", ''))";
+        }
+        else if (column->isForeignKey()) {
+            setList += "nullif(" + value + ", 0)";
+        }
+        else {
+            setList += value;
+        }
+        aliasList += ", " + column->getDbName();
+        delim = ", ";
+    }
+
+    ofs << "\tconst size_t updateChunkSize = " << chunkSizeFor(table, updateChunkSize) << ";" << endl
+        << "\tfor (size_t start = 0; start < updates.size(); start += updateChunkSize) {" << endl
+        << "\t\tsize_t end = std::min(updates.size(), start + updateChunkSize);" << endl
+        << "\t\tstring sql { \"UPDATE " << table.getDbName() << " SET " << setList << " FROM (VALUES \" };" << endl
+        << "\t\tpqxx::params params;" << endl
+        << "\t\tint paramNumber = 0;" << endl
+        << endl
+        << "\t\tfor (size_t index = start; index < end; ++index) {" << endl
+        << "\t\t\tconst " << baseClassName << " &obj = *updates[index];" << endl
+        << "\t\t\tsql += index == start ? \"(\" : \", (\";" << endl
+           ;
+
+    ofs << "\t\t\tsql += \"$\" + std::to_string(++paramNumber) + \"::" << sqlTypeFor(*pk) << "\";" << endl;
+    for (const Column::Pointer &column: table.getColumns()) {
+        if (column->getIsPrimaryKey()) {
+            continue;
+        }
+        bool isText = column->isString() || column->isTimestamp() || column->isDate();
+        ofs << "\t\t\tsql += \", $\" + std::to_string(++paramNumber)";
+        if (!isText) {
+            ofs << " + \"::" << sqlTypeFor(*column) << "\"";
+        }
+        ofs << ";" << endl;
+    }
+
+    ofs << "\t\t\tsql += \")\";" << endl
+        << "\t\t\tparams.append(obj." << pkGetter << ");" << endl
+           ;
+
+    for (const Column::Pointer &column: table.getColumns()) {
+        if (!column->getIsPrimaryKey()) {
+            string getterStr = string{"obj.get"} + firstUpper(column->getName()) + "()";
+            ofs << "\t\t\tparams.append(" << argumentFor(*column, getterStr) << ");" << endl;
+        }
+    }
+
+    ofs << "\t\t}" << endl
+        << endl
+        << "\t\tsql += \") AS batch(" << aliasList << ") WHERE " << table.getDbName() << "." << pk->getDbName()
+            << " = batch." << pk->getDbName() << "\";" << endl
+        << "\t\twork.exec_params(sql, params);" << endl
+           ;
+    if (dirtyTracking || wantCache) {
+        ofs << "\t\tfor (size_t index = start; index < end; ++index) {" << endl;
+        if (dirtyTracking) {
+            ofs << "\t\t\tupdates[index]->markClean();" << endl;
+        }
+        if (wantCache) {
+            ofs << "\t\t\t" << invalidateFor(table, "updates[index]->" + pkGetter) << endl;
+        }
+        ofs << "\t\t}" << endl;
+    }
+    ofs << "\t}" << endl
+        << "}" << endl
+        << endl
+           ;
+    generateCPP_WriterWrapper(table, ofs, myClassName, "updateAll", true, invalidateAllFor(table));
+}
+
+/**
+ * For each unique column, this writes upsert_ByXxx() and upsertAll_ByXxx(). They
+ * INSERT ... ON CONFLICT on that column, so syncing rows keyed by a natural key
+ * doesn't need a read first. Either way the row's primary key comes back.
+ */
+void CodeGenerator_DB::generateCPP_Upserts(Table &table, std::ostream &ofs, const string &myClassName) {
+    string baseClassName = table.getName();
+    const Column::Pointer pk = table.findPrimaryKey();
+    string pkSetter { string{"set"} + firstUpper(pk->getName()) };
+    string pkGetter { string{"get"} + firstUpper(pk->getName()) + "()"};
+
+    for (const Column::Pointer &column: upsertColumnsFor(table)) {
+        string methodName = string{"upsert_By"} + firstUpper(column->getName());
+
+        ofs << "void " << myClassName << "::" << methodName << "(pqxx::transaction_base &work, " << baseClassName << " &obj) {" << endl
+               ;
+
+        if (usePreparedStatements) {
+            ofs << "\tpqxx::result results = work.exec_prepared(\"" << statementName(table, methodName) << "\"";
+        }
+        else {
+            ofs << "\tpqxx::result results = work.exec_params(\"" << upsertSqlFor(table, *column) << "\"";
+        }
+        generateCPP_FieldArguments(table, ofs);
+
+        ofs << ");" << endl
+            << "\tobj." << pkSetter << "(results[0][0].as<int>());" << endl
+               ;
+        if (dirtyTracking) {
+            ofs << "\tobj.markClean();" << endl;
+        }
+        if (wantCache) {
+            ofs << "\t" << invalidateFor(table, "obj." + pkGetter) << endl;
+        }
+        ofs << "}" << endl
+            << endl
+               ;
+        generateCPP_WriterWrapper(table, ofs, myClassName, methodName, false, invalidateFor(table, "obj." + pkGetter));
+
+        //--------------------------------------------------
+        // The vector form, a chunk of rows per statement.
+        // RETURNING doesn't keep the order of the VALUES list, so we send each row
+        // a key reserved from the sequence. A row that comes back with its reserved
+        // key was inserted. One that updated an existing row has that row's key
+        // instead, and we find it by the unique column.
+        //--------------------------------------------------
+        string colGetter = string{"get"} + firstUpper(column->getName()) + "()";
+        string keyType = cTypeFor(*column, nativeTime);
+        if (keyType == "string") {
+            keyType = "std::string";
+        }
+
+        ofs << "void " << myClassName << "::upsertAll_By" << firstUpper(column->getName())
+                << "(pqxx::transaction_base &work, " << baseClassName << "::Vector &vec) {" << endl
+            << "\tconst size_t chunkSize = " << chunkSizeFor(table, insertChunkSize) << ";" << endl
+            << "\tfor (size_t start = 0; start < vec.size(); start += chunkSize) {" << endl
+            << "\t\tsize_t end = std::min(vec.size(), start + chunkSize);" << endl
+            << "\t\tpqxx::result keys = work.exec_params(\"" << reserveKeysSqlFor(table) << "\", static_cast<int>(end - start));" << endl
+            << "\t\tstring sql { string{\"INSERT INTO " << table.getDbName() << " (" << pk->getDbName()
+                << ", \"} + INSERT_LIST + \") VALUES \" };" << endl
+            << "\t\tpqxx::params params;" << endl
+            << "\t\tint paramNumber = 0;" << endl
+            << "\t\tstd::map<int, size_t> byReservedKey;" << endl
+            << "\t\tstd::map<" << keyType << ", size_t> by" << firstUpper(column->getName()) << ";" << endl
+            << endl
+            << "\t\tfor (size_t index = start; index < end; ++index) {" << endl
+            << "\t\t\tconst " << baseClassName << " &obj = *vec[index];" << endl
+            << "\t\t\tbyReservedKey[keys[index - start][0].as<int>()] = index;" << endl
+            << "\t\t\tby" << firstUpper(column->getName()) << "[obj." << colGetter << "] = index;" << endl
+               ;
+
+        generateCPP_InsertRowValues(table, ofs, "keys[index - start][0].as<int>()");
+
+        ofs << "\t\t}" << endl
+            << endl
+            << "\t\tpqxx::result results = work.exec_params(sql + \"" << onConflictFor(table, *column, true) << "\", params);" << endl
+            << "\t\tfor (const pqxx::row &row: results) {" << endl
+            << "\t\t\tint id = row[0].as<int>();" << endl
+            << "\t\t\tauto it = byReservedKey.find(id);" << endl
+            << "\t\t\tsize_t index = it != byReservedKey.end() ? it->second : by" << firstUpper(column->getName())
+                << ".at(" << fieldValue(*column, 1) << ");" << endl
+            << "\t\t\tvec[index]->" << pkSetter << "(id);" << endl
+               ;
+        if (dirtyTracking) {
+            ofs << "\t\t\tvec[index]->markClean();" << endl;
+        }
+        if (wantCache) {
+            ofs << "\t\t\t" << invalidateFor(table, "id") << endl;
+        }
+        ofs << "\t\t}" << endl
+            << "\t}" << endl
+            << "}" << endl
+            << endl
+               ;
+        generateCPP_WriterWrapper(table, ofs, myClassName, "upsertAll_By" + firstUpper(column->getName()), true,
+                                  invalidateAllFor(table));
+    }
+}
+
+/**
+ * Every generated method is written against a pqxx::transaction_base so callers
+ * can put several calls into one transaction. This writes the connection form,
+ * which runs the method in its own transaction and commits. The writers pass
+ * afterCommit to invalidate cached rows again once the commit is visible.
+ */
+void CodeGenerator_DB::generateCPP_ConnectionWrapper(
+    std::ostream &ofs,
+    const string &myClassName,
+    const string &returnType,
+    const string &methodName,
+    const string &params,
+    const string &args,
+    const string &afterCommit)
+{
+    ofs << returnType << " " << myClassName << "::" << methodName << "(pqxx::connection &conn, " << params << ") {" << endl
+        << "\tpqxx::work work {conn};" << endl
+           ;
+
+    if (returnType == "void") {
+        ofs << "\t" << methodName << "(work, " << args << ");" << endl
+            << "\twork.commit();" << endl
+               ;
+        if (!afterCommit.empty()) {
+            ofs << "\t" << afterCommit << endl;
+        }
+    }
+    else {
+        ofs << "\t" << returnType << " retVal = " << methodName << "(work, " << args << ");" << endl
+            << "\twork.commit();" << endl
+            << "\treturn retVal;" << endl
+               ;
+    }
+
+    ofs << "}" << endl
+        << endl
+           ;
+}
+
+/**
+ * The connection form of a writer. The transaction forms set new keys on the
+ * objects and mark them clean as they go, before anything is committed, so if
+ * the commit fails we put back the keys and dirty columns they had.
+ */
+void CodeGenerator_DB::generateCPP_WriterWrapper(
+    Table &table,
+    std::ostream &ofs,
+    const string &myClassName,
+    const string &methodName,
+    bool forVector,
+    const string &afterCommit)
+{
+    string baseClassName = table.getName();
+    const Column::Pointer pk = table.findPrimaryKey();
+    string pkGetter { string{"get"} + firstUpper(pk->getName()) + "()"};
+    string pkSetter { string{"set"} + firstUpper(pk->getName()) };
+
+    if (forVector) {
+        ofs << "void " << myClassName << "::" << methodName << "(pqxx::connection &conn, " << baseClassName << "::Vector &vec) {" << endl
+            << "\tstd::vector<int> savedKeys;" << endl
+            << "\tsavedKeys.reserve(vec.size());" << endl
+               ;
+        if (dirtyTracking) {
+            ofs << "\tstd::vector<" << baseClassName << "::DirtyColumns> savedDirty;" << endl
+                << "\tsavedDirty.reserve(vec.size());" << endl
+                   ;
+        }
+        ofs << "\tfor (const " << baseClassName << "::Pointer &ptr: vec) {" << endl
+            << "\t\tsavedKeys.push_back(ptr->" << pkGetter << ");" << endl
+               ;
+        if (dirtyTracking) {
+            ofs << "\t\tsavedDirty.push_back(ptr->getDirtyColumns());" << endl;
+        }
+        ofs << "\t}" << endl;
+    }
+    else {
+        ofs << "void " << myClassName << "::" << methodName << "(pqxx::connection &conn, " << baseClassName << " &obj) {" << endl
+            << "\tint savedKey = obj." << pkGetter << ";" << endl
+               ;
+        if (dirtyTracking) {
+            ofs << "\t" << baseClassName << "::DirtyColumns savedDirty = obj.getDirtyColumns();" << endl;
+        }
+    }
+
+    ofs << endl
+        << "\ttry {" << endl
+        << "\t\tpqxx::work work {conn};" << endl
+        << "\t\t" << methodName << "(work, " << (forVector ? "vec" : "obj") << ");" << endl
+        << "\t\twork.commit();" << endl
+        << "\t}" << endl
+        << "\tcatch (...) {" << endl
+           ;
+
+    if (forVector) {
+        ofs << "\t\tfor (size_t index = 0; index < vec.size(); ++index) {" << endl
+            << "\t\t\tvec[index]->" << pkSetter << "(savedKeys[index]);" << endl
+               ;
+        if (dirtyTracking) {
+            ofs << "\t\t\tvec[index]->setDirtyColumns(savedDirty[index]);" << endl;
+        }
+        ofs << "\t\t}" << endl;
+    }
+    else {
+        ofs << "\t\tobj." << pkSetter << "(savedKey);" << endl;
+        if (dirtyTracking) {
+            ofs << "\t\tobj.setDirtyColumns(savedDirty);" << endl;
+        }
+    }
+
+    ofs << "\t\tthrow;" << endl
+        << "\t}" << endl
+           ;
+    if (!afterCommit.empty()) {
+        ofs << "\t" << afterCommit << endl;
+    }
+    ofs << "}" << endl
+        << endl
+           ;
+}
+
+/**
+ * This writes prepare(), which registers every statement from statementsFor()
+ * with the connection. PostgreSQL then parses and plans each of them once per
+ * connection instead of once per call.
+ */
+void CodeGenerator_DB::generateCPP_Prepare(Table &table, std::ostream &ofs, const string &myClassName) {
+    ofs << "void " << myClassName << "::prepare(pqxx::connection &conn) {" << endl
+           ;
+
+    for (const Statement &statement: statementsFor(table)) {
+        ofs << "\tconn.prepare(\"" << statement.name << "\", \"" << statement.sql << "\");" << endl;
+    }
+
+    ofs << "}" << endl
+           ;
+}
+
+//======================================================================
+// Helpers.
+//======================================================================
+
+/**
+ * These are the statements prepare() registers. The SQL here must match the
+ * argument lists the generated methods pass to exec_prepared().
+ */
+std::vector<CodeGenerator_DB::Statement>
+CodeGenerator_DB::statementsFor(Table &table) {
+    std::vector<Statement> vec;
+    const Column::Pointer pk = table.findPrimaryKey();
+    string select = string{"SELECT "} + columnList(table, true) + " FROM " + table.getDbName();
+
+    vec.push_back( { statementName(table, "readAll"), select } );
+
+    std::ostringstream insert;
+    insert << "INSERT INTO " << table.getDbName() << " (" << columnList(table, false) << ") VALUES (";
+    generateCPP_ParameterList(table, insert, false, 1);
+    insert << ") RETURNING " << pk->getDbName();
+    vec.push_back( { statementName(table, "insert"), insert.str() } );
+
+    std::ostringstream update;
+    update << "UPDATE " << table.getDbName() << " SET ";
+    generateCPP_ParameterList(table, update, true, 2);
+    update << " WHERE " << pk->getDbName() << " = $1";
+    vec.push_back( { statementName(table, "update"), update.str() } );
+
+    for (const Column::Pointer &column: pageColumnsFor(table)) {
+        vec.push_back( { statementName(table, "readPage_By" + firstUpper(column->getName())), pageSqlFor(table, *column) } );
+    }
+
+    for (const Column::Pointer &column: upsertColumnsFor(table)) {
+        vec.push_back( { statementName(table, "upsert_By" + firstUpper(column->getName())), upsertSqlFor(table, *column) } );
+    }
+
+    if (wantCache) {
+        vec.push_back( { statementName(table, "readById"), select + " WHERE " + pk->getDbName() + " = $1" } );
+        vec.push_back( { statementName(table, "readById_ForShare"), select + " WHERE " + pk->getDbName() + " = $1 FOR SHARE" } );
+    }
+
+    vec.push_back( { statementName(table, "delete"), string{"DELETE FROM "} + table.getDbName() + " WHERE " + pk->getDbName() + " = $1" } );
 
-    //--------------------------------------------------
-    // Write the add-or-update method.
-    //--------------------------------------------------
-    string getterName { string{""} +  firstUpper(pk->getName()) };
+    for (const Column::Pointer &column: table.getColumns()) {
+        if (column->getReferences() != nullptr) {
+            vec.push_back( { statementName(table, "readAll_For" + refPtrNameFor(*column)),
+                             select + " WHERE " + column->getDbName() + " = $1" } );
+        }
+    }
 
-    ofs << "void " << myClassName << "::update(pqxx::connection &conn, " << baseClassName << " &obj) {"  << endl
-        << "\tif (obj.get" << getterName << "() == 0) {" << endl
-        << "\t\tdoInsert(conn, obj);" << endl
-        << "\t}" << endl
-        << "\telse {" << endl
-        << "\t\tdoUpdate(conn, obj);" << endl
-        << "\t}" << endl
-        << "}" << endl
-        << endl
-           ;
+    for (const Table::Pointer &mapTable: mapTablesFor(table)) {
+        vec.push_back( { statementName(table, "readAll_FromMap_" + mapTable->getName()),
+                         mapJoinSqlFor(table, *mapTable) + "$1" } );
+    }
 
-    //--------------------------------------------------
-    // Write the inserter and updater.
-    //--------------------------------------------------
-    generateCPP_DoInsert(table, ofs, myClassName);
-    generateCPP_DoUpdate(table, ofs, myClassName);
+    return vec;
+}
 
-    generateCPP_DeleteWithId(table, ofs, myClassName);
+/**
+ * Prepared statements are per connection, so the names only need to be unique
+ * across the tables in this model.
+ */
+string CodeGenerator_DB::statementName(Table &table, const string &suffix) {
+    return table.getDbName() + "_" + suffix;
 }
 
 /**
- * This generates the readAll method, which does the query and then gets the
- * other methods to parse it.
+ * This is the same list as QUERY_LIST (or INSERT_LIST without the PK), optionally
+ * qualified with the table name like QUALIFIED_QUERY_LIST.
  */
-void CodeGenerator_DB::generateCPP_ReadAll(Table &table, std::ostream &ofs, const string &myClassName) {
-    string baseClassName = table.getName();
-    const Column::Pointer pk = table.findPrimaryKey();
-    string pkGetter { string{"get"} + firstUpper(pk->getName()) + "()"};
+string CodeGenerator_DB::columnList(Table &table, bool withPrimaryKey, const string &qualifier) {
+    string retVal;
+    string delim;
 
-    ofs << baseClassName << "::Vector " << myClassName << "::readAll(pqxx::connection &conn, std::string whereClause) {" << endl
-        << "\tpqxx::work work(conn);" << endl
-        << "\tpqxx::result results = work.exec( string{\"SELECT \"} + QUERY_LIST + \" FROM " << table.getDbName()
-            << '"' << " + (whereClause.length() > 0 ? ( string{\" WHERE \"} + whereClause ): \"\""
-            << "));" << endl
-        << "\twork.commit();" << endl
-        << "\t" << baseClassName << "::Vector vec = parseAll(results);" << endl
-        << "\treturn vec;" << endl
-        << "}" << endl
-        << endl
-       ;
+    for (const Column::Pointer &column: table.getColumns()) {
+        if (withPrimaryKey || !column->getIsPrimaryKey()) {
+            retVal += delim + (qualifier.empty() ? "" : qualifier + ".") + column->getDbName();
+            delim = ", ";
+        }
+    }
+
+    return retVal;
 }
 
 /**
- * This parses the results of a query.
+ * The expression that converts field index of a row to this column's C++ type.
+ * The caller has already dealt with NULL.
  */
-void CodeGenerator_DB::generateCPP_ParseAll(Table &table, std::ostream &ofs, const string &myClassName) {
-    string baseClassName = table.getName();
-    const Column::Pointer pk = table.findPrimaryKey();
-    string pkGetter { string{"get"} + firstUpper(pk->getName()) + "()"};
+string CodeGenerator_DB::fieldValue(Column &column, int index) {
+    string cType = cTypeFor(column.getDataType());
+    string field = string{"row["} + std::to_string(index) + "]";
+    string timeName = nativeTime ? nativeTimeNameFor(column.getDataType()) : "";
 
-    ofs << baseClassName << "::Vector " << myClassName << "::parseAll(pqxx::result &results) {" << endl
-        << "\t" << baseClassName << "::Vector vec;" << endl
-        << "\tfor (pqxx::row row: results) {" << endl
-        << "\t\tvec.push_back(parseOne(row));" << endl
-        << "\t}" << endl
-        << "\treturn vec;" << endl
-        << "}" << endl
-        << endl
-       ;
+    if (!timeName.empty()) {
+        return string{"parse"} + timeName + "(std::string_view{ " + field + ".c_str(), " + field + ".size() })";
+    }
+
+    if (useFastParse) {
+        return string{"fromText<"} + (cType == "string" ? "std::string" : cType) + ">("
+            + field + ".c_str(), " + field + ".size())";
+    }
+
+    return field + ".as<" + cType + ">()";
 }
 
 /**
- * This parses the results of one row.
+ * The expression we pass to exec_params() or exec_prepared() for this column's value.
+ * libpqxx can't convert the chrono types, so with nativeTime we format those ourselves.
  */
-void CodeGenerator_DB::generateCPP_ParseOne(Table &table, std::ostream &ofs, const string &myClassName) {
-    string baseClassName = table.getName();
-    const Column::Pointer pk = table.findPrimaryKey();
-    string pkGetter { string{"get"} + firstUpper(pk->getName()) + "()"};
+string CodeGenerator_DB::argumentFor(Column &column, const string &expression) {
+    string timeName = nativeTime ? nativeTimeNameFor(column.getDataType()) : "";
+    return timeName.empty() ? expression : string{"format"} + timeName + "(" + expression + ")";
+}
 
-    ofs << baseClassName << "::Pointer " << myClassName << "::parseOne(pqxx::row &row) {" << endl
-        << "\t" << baseClassName << "::Pointer ptr = std::make_shared<" << baseClassName << ">();" << endl
-           ;
+/**
+ * For a foreign key column, this is the name we use in readAll_ForXxx.
+ */
+string CodeGenerator_DB::refPtrNameFor(Column &column) {
+    string refPtrName = firstUpper(column.getRefPtrName());
 
-    int index = 0;
-    for (const Column::Pointer &column: table.getColumns()) {
-        string cType = cTypeFor(column->getDataType());
-        string stringForNull;
+    if (refPtrName.empty()) {
+        Table::Pointer refTable = column.getReferences()->getOurTable().lock();
+        refPtrName = firstUpper(refTable->getName());
+    }
 
-        if (cType == "string") {
-            stringForNull = "\"\"";
-        }
-        else {
-            stringForNull = "0";
-        }
+    return refPtrName;
+}
 
-        ofs << "\tptr->set" << firstUpper(column->getName())
-            << "( row[" << index << "].is_null() ? " << stringForNull << " : row[" << index << "].as<" << cType << ">() );" << endl;
-               ;
+/**
+ * These are the columns we write readPage_ByXxx for: the PK first, then any we index.
+ */
+std::vector<Column::Pointer> CodeGenerator_DB::pageColumnsFor(Table &table) {
+    std::vector<Column::Pointer> vec;
+    const Column::Pointer pk = table.findPrimaryKey();
 
-        ++index;
+    vec.push_back(pk);
+    for (const Column::Pointer &column: table.getColumns()) {
+        if (column != pk && column->getWantIndex()) {
+            vec.push_back(column);
+        }
     }
 
-    ofs
-        << "\treturn ptr;" << endl
-        << "}" << endl
-        << endl
-       ;
+    return vec;
 }
 
 /**
- * This generates any readers based on having FK relationships.
+ * The SQL for one page. Off the PK, the row comparison (col, pk) > ($1, $2) gives
+ * us a stable order even with duplicate values in col.
  */
-void
-CodeGenerator_DB::generateCPP_FromForeignKeys(Table &table, std::ostream &ofs, const string &myClassName) {
-    string baseClassName = table.getName();
+string CodeGenerator_DB::pageSqlFor(Table &table, Column &column) {
+    const Column::Pointer pk = table.findPrimaryKey();
+    string select = string{"SELECT "} + columnList(table, true) + " FROM " + table.getDbName();
 
-    for (const Column::Pointer &column: table.getColumns()) {
-        Column::Pointer fk = column->getReferences();
-        if (fk != nullptr) {
-            std::shared_ptr<Table> refTable = fk->getOurTable().lock();
-            string refPtrName = firstUpper(column->getRefPtrName());
+    if (column.getIsPrimaryKey()) {
+        return select + " WHERE " + pk->getDbName() + " > $1 ORDER BY " + pk->getDbName() + " LIMIT $2";
+    }
 
-            if (refPtrName.empty()) {
-                refPtrName = firstUpper(refTable->getName());
-            }
+    string key = string{"("} + column.getDbName() + ", " + pk->getDbName() + ")";
+    std::pair<string, string> wrapper = parameterWrapperFor(column);
 
-            ofs << baseClassName << "::Vector " << myClassName << "::readAll_For" << refPtrName
-                << "(pqxx::connection &conn, int " << column->getName() << ") {"  << endl
-                << "\tpqxx::work work(conn);" << endl
-                << "\tpqxx::result results = work.exec( string{\"SELECT \"} + QUERY_LIST + \" FROM " << table.getDbName()
-                << " WHERE " << column->getDbName() << " = \" + std::to_string(" << column->getName() << "));" << endl
-                << "\twork.commit();" << endl
-                << "\t" << baseClassName << "::Vector vec = parseAll(results);" << endl
-                << "\treturn vec;" << endl
-               ;
-            ofs << "}" << endl << endl;
+    // A row comparison is never true for NULL, so those rows would never come back.
+    // Where the caller has a value that means NULL (an empty string or a zero foreign
+    // key), NULLs sort first and a page that ended on one picks up from there.
+    if (column.getNullable() && wrapper.first != "$") {
+        string after = wrapper.first + "1" + wrapper.second;
+        if (column.isTimestamp()) {
+            after += "::" + sqlTypeFor(column);
         }
+
+        return select + " WHERE (" + after + " IS NULL AND (" + column.getDbName() + " IS NOT NULL OR "
+            + pk->getDbName() + " > $2)) OR " + key + " > (" + after + ", $2)"
+            + " ORDER BY " + column.getDbName() + " NULLS FIRST, " + pk->getDbName() + " LIMIT $3";
     }
+
+    return select + " WHERE " + key + " > ($1, $2)"
+        + " ORDER BY " + column.getDbName() + ", " + pk->getDbName() + " LIMIT $3";
 }
 
 /**
- * This generates readers based on map tables, which
- * a join, and is complicated to write, even though the SQL
- * really is pretty trivial.
+ * What the generated doc comments pass as a connection string: the pool's lookup of
+ * the model's first database, if we have both, or else a literal.
  */
-void
-CodeGenerator_DB::generateCPP_FromMapFiles(Table &table, std::ostream &ofs, const string &myClassName) {
-    for (const Table::Pointer &thisTable: model.getTables()) {
-        if (thisTable->getName() != table.getName() && thisTable->looksLikeMapTableFor(table)) {
-            const Column::Pointer otherRef = thisTable->otherMapTableReference(table);
-            if (otherRef == nullptr) {
-                continue;
-            }
-            generateCPP_ThisMap(table, ofs, *thisTable, myClassName);
-        }
+string CodeGenerator_DB::exampleConnectionString() {
+    const DataModel::Database::Vector &databases = model.getDatabases();
+    if (wantConnectionPool && !databases.empty()) {
+        return string{"DB_ConnectionPool::connectionStringFor(\""} + databases[0]->getEnvName() + "\")";
     }
+    return databases.empty() || databases[0]->getDbName().empty()
+        ? "\"dbname=mydb\""
+        : string{"\"dbname="} + databases[0]->getDbName() + "\"";
 }
 
 /**
- * Generates a join.
- *
- *    SELECT foo.* FROM foo, bar WHERE foo.id = bar.foo_id AND bar.gleep_id = 10
+ * The C++ type (with trailing space or &) we use when passing this column as an argument.
  */
-void
-CodeGenerator_DB::generateCPP_ThisMap(
-    Table &table,			// The table we're returning
-    std::ostream &ofs,					// Output stream
-    Table &mapTable,			// The mapping table
-    const std::string &myClassName)
-{
-    string baseClassName = table.getName();
-    Column::Pointer colToUs = mapTable.ourMapTableReference(table);
-    Column::Pointer ourKeyColumn = colToUs->getReferences();
-
-    Column::Pointer colToThem = mapTable.otherMapTableReference(table);
+string CodeGenerator_DB::paramTypeFor(Column &column) {
+    string cType = cTypeFor(column, nativeTime);
+    return cType == "string" ? "const std::string &" : cType + " ";
+}
 
-    ofs << baseClassName << "::Vector " << myClassName << "::readAll_FromMap_"
-        << mapTable.getName() << "(pqxx::connection &conn, int " << colToThem->getName() << ") {"  << endl
-        << "\tpqxx::work work(conn);" << endl
-        << "\tpqxx::result results = work.exec( string{\"SELECT \"} + QUALIFIED_QUERY_LIST + \" FROM "
-        << table.getDbName() << ", " << mapTable.getDbName()
+/**
+ * What goes either side of a parameter number in INSERT and UPDATE, so empty
+ * strings and zero foreign keys become NULL.
+ */
+std::pair<string, string> CodeGenerator_DB::parameterWrapperFor(Column &column) {
+    if (column.isString() || column.isTimestamp()) {
+        return { "nullif($", ", '')" };
+    }
+    if (column.isDate()) {
+        return { "date(nullif($", ", ''))" };
+    }
+    if (column.isForeignKey()) {
+        return { "nullif($", ", 0)" };
+    }
+    return { "$", "" };
+}
 
-        // This is the join to us
-        << " WHERE " << table.getDbName() << "." << ourKeyColumn->getDbName() << " = "
-        << mapTable.getDbName() << "." << colToUs->getDbName()
+/**
+ * The tables with a foreign key to this one, each listed once. This table
+ * is on the list if it refers to itself.
+ */
+std::vector<Table::Pointer> CodeGenerator_DB::childTablesFor(Table &table) {
+    return model.getRelationships().childTables(table);
+}
 
-        // And this is the join from the distant table, which is from the method's argument list
-        << " AND " << mapTable.getDbName() << "." << colToThem->getDbName() << " = "
-        << "\" + std::to_string(" << colToThem->getName() << "));" << endl
+/**
+ * The tables this one has a foreign key to, each listed once.
+ */
+std::vector<Table::Pointer> CodeGenerator_DB::parentTablesFor(Table &table) {
+    return model.getRelationships().parentTables(table);
+}
 
-        << "\twork.commit();" << endl
-        << "\t" << baseClassName << "::Vector vec = parseAll(results);" << endl
-        << "\treturn vec;" << endl
-       ;
-    ofs << "}" << endl << endl;
+/**
+ * The map tables that give us a readAll_FromMap_Xxx.
+ */
+std::vector<Table::Pointer> CodeGenerator_DB::mapTablesFor(Table &table) {
+    return model.getRelationships().mapTables(table);
 }
 
 /**
- * This writes the doInsert method.
+ * The join behind readAll_FromMap_Xxx, up to but not including the value
+ * for the distant table's key.
  */
-void CodeGenerator_DB::generateCPP_DoInsert(Table &table, std::ostream &ofs, const string &myClassName) {
-    string baseClassName = table.getName();
-    const Column::Pointer pk = table.findPrimaryKey();
-    string pkGetter { string{"get"} + firstUpper(pk->getName()) + "()"};
+string CodeGenerator_DB::mapJoinSqlFor(Table &table, Table &mapTable) {
+    Column::Pointer colToThem = mapTable.otherMapTableReference(table);
+    Column::Pointer colToUs = mapTable.ourMapTableReference(table);
+    Column::Pointer ourKeyColumn = colToUs->getReferences();
 
-    ofs << "void " << myClassName << "::doInsert(pqxx::connection &conn, " << baseClassName << " &obj) {"  << endl
-        << "\tpqxx::work work {conn};" << endl
-        << "\tstring sql { string{\"INSERT INTO " << table.getDbName()
-            << " (\"} + INSERT_LIST + \")"
-            << " VALUES ("
-               ;
+    return string{"SELECT "} + columnList(table, true, table.getDbName())
+        + " FROM " + table.getDbName() + ", " + mapTable.getDbName()
+        + " WHERE " + table.getDbName() + "." + ourKeyColumn->getDbName()
+        + " = " + mapTable.getDbName() + "." + colToUs->getDbName()
+        + " AND " + mapTable.getDbName() + "." + colToThem->getDbName() + " = ";
+}
 
-    generateCPP_ParameterList(table, ofs, false, 1);
+/**
+ * The columns we write upserts for. ON CONFLICT needs a unique index, so a plain
+ * wantIndex isn't enough.
+ */
+std::vector<Column::Pointer> CodeGenerator_DB::upsertColumnsFor(Table &table) {
+    std::vector<Column::Pointer> vec;
 
-    ofs << ") RETURNING " << pk->getDbName() << "\" };" << endl
-        << "\tpqxx::result results = work.exec_params(sql";
+    for (const Column::Pointer &column: table.getColumns()) {
+        if (!column->getIsPrimaryKey() && column->getUnique()) {
+            vec.push_back(column);
+        }
+    }
 
-    generateCPP_FieldArguments(table, ofs);
+    return vec;
+}
 
-    ofs << ");" << endl
-        << "\twork.commit();" << endl
-        << "\tobj.set" << firstUpper(pk->getName()) << "(results[0][0].as<int>()" << ");" << endl
-        << "}" << endl
-        << endl
-           ;
+/**
+ * How many rows to send in each multi-row statement. PostgreSQL takes at most 65535
+ * parameters in one, and each row sends one for every column, key included.
+ */
+int CodeGenerator_DB::chunkSizeFor(Table &table, int configured) {
+    int maxRows = std::max(1, 65535 / static_cast<int>(table.getColumns().size()));
+    return std::min(configured, maxRows);
 }
 
+/**
+ * The query insertAll() and updateAll() use to reserve $1 keys from the primary
+ * key's sequence, one row each.
+ */
+string CodeGenerator_DB::reserveKeysSqlFor(Table &table) {
+    const Column::Pointer pk = table.findPrimaryKey();
+    return string{"SELECT nextval(pg_get_serial_sequence('"} + table.getDbName() + "', '" + pk->getDbName()
+        + "')) FROM generate_series(1, $1)";
+}
 
 /**
- * This writes the doUpdate() method, which is similar to the doInsert() method,
- * but of course, SQL UPDATE statements aren't identical to INSERT statements.
+ * The tail of an upsert on this column: on a conflict, overwrite the other
+ * columns with the new values, and hand back the primary key either way,
+ * and with returnColumn, this column after it.
  */
-void CodeGenerator_DB::generateCPP_DoUpdate(Table &table, std::ostream &ofs, const string &myClassName) {
-    string baseClassName = table.getName();
+string CodeGenerator_DB::onConflictFor(Table &table, Column &column, bool returnColumn) {
     const Column::Pointer pk = table.findPrimaryKey();
-    string pkGetter { string{"get"} + firstUpper(pk->getName()) + "()"};
+    string retVal = string{" ON CONFLICT ("} + column.getDbName() + ") DO UPDATE SET ";
+    string delim;
 
-    ofs << "void " << myClassName << "::doUpdate(pqxx::connection &conn, " << baseClassName << " &obj) {"  << endl
-        << "\tpqxx::work work {conn};" << endl
-        << "\tstring sql { \"UPDATE " << table.getDbName() << " SET "
-           ;
+    for (const Column::Pointer &other: table.getColumns()) {
+        if (!other->getIsPrimaryKey()) {
+            retVal += delim + other->getDbName() + " = EXCLUDED." + other->getDbName();
+            delim = ", ";
+        }
+    }
 
-    generateCPP_ParameterList(table, ofs, true, 2);
+    return retVal + " RETURNING " + pk->getDbName() + (returnColumn ? ", " + column.getDbName() : "");
+}
 
-    ofs << " WHERE " << pk->getDbName() << " = $1\" };" << endl
-        << "\tpqxx::result results = work.exec_params(sql, obj." << pkGetter
-           ;
+/**
+ * The single-row upsert: our usual INSERT, plus onConflictFor().
+ */
+string CodeGenerator_DB::upsertSqlFor(Table &table, Column &column) {
+    std::ostringstream sql;
 
-    generateCPP_FieldArguments(table, ofs);
+    sql << "INSERT INTO " << table.getDbName() << " (" << columnList(table, false) << ") VALUES (";
+    generateCPP_ParameterList(table, sql, false, 1);
+    sql << ")" << onConflictFor(table, column);
 
-    ofs << ");" << endl
-        << "\twork.commit();" << endl
-        << "}" << endl
-        << endl
-           ;
+    return sql.str();
 }
 
 /**
- * We're building an INSERT or UPDATE statement. This is the VALUES portion, which
- * will be a bunch of $1, $2, nullif($3,0), etc.
+ * A value for a libpq keyword=value connection string, quoted and escaped, and
+ * then escaped again to sit inside a C++ string literal.
  */
-void
-CodeGenerator_DB::generateCPP_ParameterList(DataModel::Table &table, std::ostream &ofs, bool forUpdate, int startIndex) {
-    string delim {""};
-    for (const Column::Pointer &column: table.getColumns()) {
-        if (!column->getIsPrimaryKey()) {
-            ofs << delim;
+string CodeGenerator_DB::connectionValue(const string &value) {
+    string retVal { "'" };
 
-            if (forUpdate) {
-                ofs << column->getDbName() << " = ";
-            }
-            if (column->isString() || column->isTimestamp()) {
-                ofs << "nullif($" << startIndex << ", '')";
-            }
-            else if (column->isDate()) {
-                ofs << "date(nullif($" << startIndex << ", ''))";
-            }
-            else if (column->isForeignKey()) {
-                ofs << "nullif($" << startIndex << ", 0)";
-            }
-            else {
-                ofs << "$" << startIndex;
-            }
-            delim = ", ";
-            ++startIndex;
+    for (char c: value) {
+        if (c == '\'') {
+            retVal += "\\\\'";
+        }
+        else if (c == '\\') {
+            retVal += "\\\\\\\\";
+        }
+        else if (c == '"') {
+            retVal += "\\\"";
+        }
+        else {
+            retVal += c;
         }
     }
+
+    return retVal + "'";
 }
 
 /**
- * This is used to do the latter part of work.exec_params(). We have to handle
- * nulls / empty strings, 0s in foreign keys.
+ * The PostgreSQL type we cast to when a value's type can't be inferred, as in
+ * a VALUES list. The serial types are just integers once they're in a column.
  */
-void
-CodeGenerator_DB::generateCPP_FieldArguments(DataModel::Table &table, std::ostream &ofs) {
-    for (const Column::Pointer &column: table.getColumns()) {
-        if (!column->getIsPrimaryKey()) {
-            string getterStr = string{"obj.get"} + firstUpper(column->getName()) + "()";
-            ofs << ",\n\t\t";
-            ofs << getterStr;
-        }
+string CodeGenerator_DB::sqlTypeFor(Column &column) {
+    switch (column.getDataType()) {
+        case DataType::Serial:      return "integer";
+        case DataType::BigSerial:   return "bigint";
+        case DataType::Double:      return "double precision";
+        default:                            return toLower(toString(column.getDataType()));
     }
 }
 
 /**
- * This writes deleteWithId().
+ * With the cache option, the statement that drops this row from DB_Foo_Cached.
  */
-void CodeGenerator_DB::generateCPP_DeleteWithId(Table &table, std::ostream &ofs, const string &myClassName) {
-    string baseClassName = table.getName();
-    const Column::Pointer pk = table.findPrimaryKey();
-    string pkGetter { string{"get"} + firstUpper(pk->getName()) + "()"};
+string CodeGenerator_DB::invalidateFor(Table &table, const string &idExpression) {
+    if (!wantCache) {
+        return "";
+    }
+    return string{"DB_"} + table.getName() + "_Cached::invalidate(" + idExpression + ");";
+}
 
-    ofs << "void " << myClassName << "::deleteWithId(pqxx::connection &conn, int id) {"  << endl
-        << "\tpqxx::work work {conn};" << endl
-        << "\twork.exec_params(\"DELETE FROM " << table.getDbName() << " WHERE " << pk->getDbName() << " = $1\", id);" << endl
-        << "\twork.commit();" << endl
-        << "}" << endl
-           ;
+/**
+ * The same for every row of vec, for the vector writers.
+ */
+string CodeGenerator_DB::invalidateAllFor(Table &table) {
+    if (!wantCache) {
+        return "";
+    }
+    const Column::Pointer pk = table.findPrimaryKey();
+    return string{"for (const "} + table.getName() + "::Pointer &ptr: vec) { "
+        + invalidateFor(table, "ptr->get" + firstUpper(pk->getName()) + "()") + " }";
 }
 
 //======================================================================
@@ -560,7 +3076,7 @@ void CodeGenerator_DB::generateConcreteH(Table &table)
     string hName = generatorInfo->getOutputBasePath() + "/" + myClassName + ".h";
 
     if (!std::filesystem::exists(hName)) {
-        std::ofstream ofs{hName};
+        OutputFile ofs{hName};
 
         ofs << "#pragma once" << endl
             << endl
@@ -585,7 +3101,7 @@ void CodeGenerator_DB::generateConcreteCPP(Table &table)
     string cppName = generatorInfo->getOutputBasePath() + "/" + myClassName + ".cpp";
 
     if (!std::filesystem::exists(cppName)) {
-        std::ofstream ofs{cppName};
+        OutputFile ofs{cppName};
         ofs << "#include <" << cppIncludePath << myClassName << ".h>" << endl
             << endl
             << myClassName << "::~" << myClassName << "() {" << endl
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include <vector>
 
 #include "CodeGenerator.h"
 
@@ -18,31 +19,140 @@ public:
     std::string cppStubDirName;
     std::string cppIncludePath;
 
+    /** If set, we generate prepare() and the CRUD methods use exec_prepared(). */
+    bool usePreparedStatements = false;
+
+    /** If set, we also generate readAllValues(), which returns Foo_Value structs. */
+    bool wantValueTypes = false;
+
+    /** If set, we also generate readColumns(), which fills a Foo_Columns snapshot. */
+    bool wantColumnSnapshots = false;
+
+    /** If set, readers parse fields with std::from_chars rather than as<T>(). */
+    bool useFastParse = false;
+
+    /** If set, Date and Timestamp columns are std::chrono types, to match the C++ generator's option. */
+    bool nativeTime = false;
+
+    /** How many rows updateAll() puts in each multi-row INSERT. */
+    int insertChunkSize = 500;
+
+    /** How many rows updateAll() puts in each UPDATE ... FROM (VALUES ...). */
+    int updateChunkSize = 500;
+
+    /** If set, we also write base/DB_ConnectionPool.h. */
+    bool wantConnectionPool = false;
+
+    /** The pool's default number of connections. */
+    int poolSize = 8;
+
+    /** If set, doUpdate() writes only dirty columns, to match the C++ generator's option. */
+    bool dirtyTracking = false;
+
+    /** If set, we also write base/DB_Cache.h and a DB_Foo_Cached read-through cache per table. */
+    bool wantCache = false;
+
+    /** How many rows each table's cache holds. */
+    int cacheCapacity = 10000;
+
+    /** How many independently locked shards each table's cache is split into. */
+    int cacheShards = 16;
+
+    /** If set, we also write base/DB_NotifyListener.h, to match the SQL generators' notifyTriggers option. */
+    bool wantNotifyListener = false;
+
 private:
+    /**
+     * A named statement we register with the connection in prepare().
+     */
+    class Statement {
+    public:
+        std::string name;
+        std::string sql;
+    };
+
     // These methods generate the base classes into the stubDir.
+    void generateUtilities();
+    void generateConnectionPool();
+    void generateCache();
+    void generateCached(DataModel::Table &);
+    void generateNotifyListener();
     void generateH(DataModel::Table &);
     void generateCPP(DataModel::Table &);
 
     void generateCPP_ReadAll(DataModel::Table &, std::ostream &, const std::string &myClassName);
+    void generateCPP_ReadEach(DataModel::Table &, std::ostream &, const std::string &myClassName);
+    void generateCPP_ReadAllValues(DataModel::Table &, std::ostream &, const std::string &myClassName);
+    void generateCPP_ReadColumns(DataModel::Table &, std::ostream &, const std::string &myClassName);
+    void generateCPP_ReadAllQuery(DataModel::Table &, std::ostream &);
+    void generateCPP_ReadPages(DataModel::Table &, std::ostream &, const std::string &myClassName);
     void generateCPP_ParseAll(DataModel::Table &, std::ostream &, const std::string &myClassName);
     void generateCPP_ParseOne(DataModel::Table &, std::ostream &, const std::string &myClassName);
     void generateCPP_DoInsert(DataModel::Table &, std::ostream &, const std::string &myClassName);
     void generateCPP_DoUpdate(DataModel::Table &, std::ostream &, const std::string &myClassName);
+    void generateCPP_DirtyUpdate(DataModel::Table &, std::ostream &, const std::string &myClassName);
     void generateCPP_DeleteWithId(DataModel::Table &, std::ostream &, const std::string &myClassName);
+    void generateCPP_InsertAll(DataModel::Table &, std::ostream &, const std::string &myClassName);
+    void generateCPP_UpdateAll(DataModel::Table &, std::ostream &, const std::string &myClassName);
+    void generateCPP_Upserts(DataModel::Table &, std::ostream &, const std::string &myClassName);
+    void generateCPP_InsertRowValues(DataModel::Table &, std::ostream &, const std::string &keyExpression = "");
+
+    void generateCPP_ConnectionWrapper(std::ostream &,
+                                       const std::string &myClassName,
+                                       const std::string &returnType,
+                                       const std::string &methodName,
+                                       const std::string &params,
+                                       const std::string &args,
+                                       const std::string &afterCommit = "");
+    void generateCPP_WriterWrapper(DataModel::Table &,
+                                   std::ostream &,
+                                   const std::string &myClassName,
+                                   const std::string &methodName,
+                                   bool forVector,
+                                   const std::string &afterCommit = "");
+    void generateCPP_Prepare(DataModel::Table &, std::ostream &, const std::string &myClassName);
 
     void generateCPP_ParameterList(DataModel::Table &, std::ostream &, bool forUpdate, int startIndex = 1);
     void generateCPP_FieldArguments(DataModel::Table &, std::ostream &);
+    void generateCPP_CopyArguments(DataModel::Table &, std::ostream &);
 
     void generateH_FromForeignKeys(DataModel::Table &, std::ostream &, const std::string &myClassName);
     void generateCPP_FromForeignKeys(DataModel::Table &, std::ostream &, const std::string &myClassName);
     void generateH_FromMapFiles(DataModel::Table &, std::ostream &, const std::string &myClassName);
     void generateCPP_FromMapFiles(DataModel::Table &, std::ostream &, const std::string &myClassName);
+    void generateCPP_QueueReaders(DataModel::Table &, std::ostream &, const std::string &myClassName);
+    void generateCPP_ReadGraph(DataModel::Table &, std::ostream &, const std::string &myClassName);
 
     void generateCPP_ThisMap(DataModel::Table &,
                              std::ostream &,
                              DataModel::Table &,
                              const std::string &myClassName);
 
+    std::vector<Statement> statementsFor(DataModel::Table &);
+    std::string statementName(DataModel::Table &, const std::string &suffix);
+    std::string columnList(DataModel::Table &, bool withPrimaryKey, const std::string &qualifier = "");
+    std::string refPtrNameFor(DataModel::Column &);
+    std::string fieldValue(DataModel::Column &, int index);
+    std::string argumentFor(DataModel::Column &, const std::string &expression);
+    std::vector<DataModel::Column::Pointer> pageColumnsFor(DataModel::Table &);
+    std::string pageSqlFor(DataModel::Table &, DataModel::Column &);
+    std::string paramTypeFor(DataModel::Column &);
+    std::pair<std::string, std::string> parameterWrapperFor(DataModel::Column &);
+    std::string sqlTypeFor(DataModel::Column &);
+    std::string connectionValue(const std::string &);
+    std::string exampleConnectionString();
+    std::string invalidateFor(DataModel::Table &, const std::string &idExpression);
+    std::string invalidateAllFor(DataModel::Table &);
+    std::vector<DataModel::Table::Pointer> mapTablesFor(DataModel::Table &);
+    std::vector<DataModel::Table::Pointer> childTablesFor(DataModel::Table &);
+    std::vector<DataModel::Table::Pointer> parentTablesFor(DataModel::Table &);
+    std::string mapJoinSqlFor(DataModel::Table &, DataModel::Table &mapTable);
+    std::string reserveKeysSqlFor(DataModel::Table &);
+    int chunkSizeFor(DataModel::Table &, int configured);
+    std::vector<DataModel::Column::Pointer> upsertColumnsFor(DataModel::Table &);
+    std::string onConflictFor(DataModel::Table &, DataModel::Column &, bool returnColumn = false);
+    std::string upsertSqlFor(DataModel::Table &, DataModel::Column &);
+
     // This generates subclasses only if they don't already exist.
     void generateConcreteH(DataModel::Table &);
     void generateConcreteCPP(DataModel::Table &);
@@ -24,6 +24,7 @@ CodeGenerator_Flyway::CodeGenerator_Flyway(DataModel &m, DataModel::Generator::P
  * Generate. We should support some of what we generate as flags, but I'm not going to worry about that yet.
  */
 void CodeGenerator_Flyway::generate() {
+    readOptions();
     generate_ConfigFiles();
     if (generate_Migrations()) {
         saveModel();
@@ -106,6 +107,9 @@ bool CodeGenerator_Flyway::generate_Migrations() {
         generateTo( fname );
         for (const Table::Pointer & table: model.getTables()) {
             setGeneratedNames(*table);
+            if (notifyTriggers && table->findPrimaryKey() != nullptr) {
+                table->setNotifyTriggerGenerated(true);
+            }
         }
         return true;
     }
@@ -163,6 +167,13 @@ bool CodeGenerator_Flyway::generate_TableMigrations(std::ofstream &ofs, const Ta
         if (table->getVersion() > genVersion) {
             ofs << "\n";
 
+            // The trigger names the old table in its function, channel and primary key.
+            if (notifyTriggers && !table->getDbNameGenerated().empty() && table->getDbName() != table->getDbNameGenerated()) {
+                string oldName = table->getDbNameGenerated() + "_notify";
+                ofs << "DROP TRIGGER IF EXISTS " << oldName << " ON " << table->getDbNameGenerated() << ";\n"
+                    << "DROP FUNCTION IF EXISTS " << oldName << "();\n";
+            }
+
             generate_TableNameChanges(ofs, table);
             generate_ColumnChanges(ofs, table);
 
@@ -175,6 +186,17 @@ bool CodeGenerator_Flyway::generate_TableMigrations(std::ofstream &ofs, const Ta
         cout << "Changes in " << table->getName() << endl;
     }
 
+    // A table that predates notifyTriggers gets its trigger once, even if nothing else changed.
+    // Without a primary key there's no trigger, so it stays unmarked until it has one.
+    if (notifyTriggers && table->findPrimaryKey() != nullptr && (didWork || !table->getNotifyTriggerGenerated())) {
+        if (!didWork) {
+            ofs << "\n";
+        }
+        generateNotifyTrigger(ofs, *table);
+        table->setNotifyTriggerGenerated(true);
+        didWork = true;
+    }
+
     return didWork;
 }
 
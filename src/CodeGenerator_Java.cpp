@@ -50,10 +50,10 @@ void CodeGenerator_Java::generate() {
         }
     }
 
-    for (const Table::Pointer & table: model.getTables()) {
+    forEachTable([this](const Table::Pointer &table) {
         generatePOJO(table);
         generateRepository(table);
-    }
+    });
 }
 
 /**
@@ -67,7 +67,7 @@ void CodeGenerator_Java::generatePOJO(DataModel::Table::Pointer table) {
 
     std::filesystem::create_directories(basePath);
 
-    std::ofstream ofs{path};
+    OutputFile ofs{path};
 
     ofs << "package " << generatorInfo->getOutputClassPath() << ".dbmodel;\n"
         << "\n"
@@ -252,7 +252,7 @@ void CodeGenerator_Java::generatePOJO(DataModel::Table::Pointer table) {
  *  @Column(insertable = false, updatable = false)
  *  Integer tutorialId;
  */
-void CodeGenerator_Java::generateForeignKey(std::ofstream & ofs, DataModel::Column::Pointer column) {
+void CodeGenerator_Java::generateForeignKey(std::ostream & ofs, DataModel::Column::Pointer column) {
     Column::Pointer remoteColumn = column->getReferences();
     Table::Pointer remoteTable = remoteColumn->getOurTable().lock();
     string name = column->getRefPtrName();
@@ -285,7 +285,7 @@ void CodeGenerator_Java::generateRepository(Table::Pointer table) {
         return;
     }
 
-    std::ofstream ofs{path};
+    OutputFile ofs{path};
 
     ofs << "package " << generatorInfo->getOutputClassPath() << ".repository;\n"
         << "\n"
@@ -12,7 +12,7 @@ public:
 private:
     void generatePOJO(DataModel::Table::Pointer table);
     void generateRepository(DataModel::Table::Pointer table);
-    void generateForeignKey(std::ofstream & ofs, DataModel::Column::Pointer column);
+    void generateForeignKey(std::ostream & ofs, DataModel::Column::Pointer column);
 
     std::string javaType(DataModel::Column::DataType dt);
 
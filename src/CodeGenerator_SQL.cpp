@@ -25,16 +25,29 @@ CodeGenerator_SQL::CodeGenerator_SQL(const std::string & _name, DataModel &_mode
  */
 void
 CodeGenerator_SQL::generate() {
+    readOptions();
     generateTo(generatorInfo->getOutputBasePath());
 }
 
+/**
+ * Flyway shares our options.
+ */
+void
+CodeGenerator_SQL::readOptions() {
+    for (auto const& [key, value] : generatorInfo->getOptions()) {
+        if (key == "notifyTriggers") {
+            notifyTriggers = value == "true";
+        }
+    }
+}
+
 /**
  * Generate our output file. We broke this out of generate() so we can subclass
  * (for Flyway) and specify an alternate location.
  */
 void
 CodeGenerator_SQL::generateTo(const string &filename) {
-    std::ofstream ofs{ filename };
+    OutputFile ofs{ filename };
 
     ofs << "BEGIN;" << endl;
 
@@ -66,6 +79,13 @@ CodeGenerator_SQL::generateTo(const string &filename) {
         generateIndexes(ofs, *table);
     }
 
+    if (notifyTriggers) {
+        for (const Table::Pointer & table: model.getTables()) {
+            ofs << endl;
+            generateNotifyTrigger(ofs, *table);
+        }
+    }
+
     ofs << endl;
     ofs << "COMMIT;" << endl;
 }
@@ -79,7 +99,7 @@ CodeGenerator_SQL::generateTo(const string &filename) {
  * );
  */
 void
-CodeGenerator_SQL::generateForTable(std::ofstream &ofs, const Table &table) {
+CodeGenerator_SQL::generateForTable(std::ostream &ofs, const Table &table) {
     //======================================================================
     // If the primary key is not a Serial type, then we manually create
     // the sequence we'll use.
@@ -124,7 +144,7 @@ CodeGenerator_SQL::generateForTable(std::ofstream &ofs, const Table &table) {
 /**
  * We're in either a "CREATE TABLE" or "ALTER TABLE foo ADD COLUMN" and we want the rest.
  */
-std::ofstream & CodeGenerator_SQL::generateDefinitionFor(std::ofstream &ofs, const Column &column) {
+std::ostream & CodeGenerator_SQL::generateDefinitionFor(std::ostream &ofs, const Column &column) {
     DataType dt = column.getDataType();
     ofs << "        " << column.getDbName() << " " << toString(dt);
 
@@ -166,7 +186,7 @@ std::ofstream & CodeGenerator_SQL::generateDefinitionFor(std::ofstream &ofs, con
  * REFERENCES parent_table (parent_key_columns)
  * [ ON DELETE CASCADE ];
  */
-void CodeGenerator_SQL::generateForeignKeys(std::ofstream &ofs, const DataModel::Table &table) {
+void CodeGenerator_SQL::generateForeignKeys(std::ostream &ofs, const DataModel::Table &table) {
     for (const Column::Pointer &column: table.getColumns()) {
         Column::Pointer references = column->getReferences();
         if (references != nullptr) {
@@ -182,14 +202,52 @@ void CodeGenerator_SQL::generateForeignKeys(std::ofstream &ofs, const DataModel:
 /**
  * Generate CREATE INDEX for this table.
  */
-void CodeGenerator_SQL::generateIndexes(std::ofstream &ofs, const DataModel::Table &table) {
+void CodeGenerator_SQL::generateIndexes(std::ostream &ofs, const DataModel::Table &table) {
     //======================================================================
     // Add requested indexes.
     //======================================================================
     for (const Column::Pointer &column: table.getColumns()) {
-        if (!column->getIsPrimaryKey() && column->getWantIndex()) {
+        if (!column->getIsPrimaryKey() && column->getUnique()) {
+            ofs << "   CREATE UNIQUE INDEX ON " << table.getDbName() << " (" << column->getDbName() << ");" << endl;
+        }
+        else if (!column->getIsPrimaryKey() && column->getWantIndex()) {
             ofs << "   CREATE INDEX ON " << table.getDbName() << " (" << column->getDbName() << ");" << endl;
         }
     }
 }
 
+/**
+ * With notifyTriggers, every insert, update and delete sends pg_notify() on the table's
+ * channel with "I:id", "U:id" or "D:id" as the payload. An update that changes the primary
+ * key sends both keys. PostgreSQL sends notifications when the transaction commits, and
+ * only once for each distinct payload, so a transaction that touches a row many times
+ * sends one. Tables without a primary key don't get a trigger.
+ *
+ * We drop the trigger before creating it, so migrations can use this to replace one.
+ */
+void CodeGenerator_SQL::generateNotifyTrigger(std::ostream &ofs, const Table &table) {
+    const Column::Pointer pk = table.findPrimaryKey();
+    if (pk == nullptr) {
+        return;
+    }
+
+    string name = table.getDbName() + "_notify";
+    string channel = notifyChannelFor(table);
+    string pkName = pk->getDbName();
+
+    ofs << "    CREATE OR REPLACE FUNCTION " << name << "() RETURNS trigger AS $$" << endl
+        << "    BEGIN" << endl
+        << "        IF TG_OP <> 'INSERT' THEN" << endl
+        << "            PERFORM pg_notify('" << channel << "', left(TG_OP, 1) || ':' || OLD." << pkName << ");" << endl
+        << "        END IF;" << endl
+        << "        IF TG_OP = 'INSERT' OR (TG_OP = 'UPDATE' AND NEW." << pkName << " IS DISTINCT FROM OLD." << pkName << ") THEN" << endl
+        << "            PERFORM pg_notify('" << channel << "', left(TG_OP, 1) || ':' || NEW." << pkName << ");" << endl
+        << "        END IF;" << endl
+        << "        RETURN NULL;" << endl
+        << "    END;" << endl
+        << "    $$ LANGUAGE plpgsql;" << endl
+        << "    DROP TRIGGER IF EXISTS " << name << " ON " << table.getDbName() << ";" << endl
+        << "    CREATE TRIGGER " << name << " AFTER INSERT OR UPDATE OR DELETE ON " << table.getDbName()
+            << " FOR EACH ROW EXECUTE FUNCTION " << name << "();" << endl
+           ;
+}
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <fstream>
+#include <iostream>
 
 #include "CodeGenerator.h"
 
@@ -17,13 +17,19 @@ public:
 
     void generate() override;
 
+    static void generateNotifyTrigger(std::ostream &, const Table &);
+
+    /** If set, each table gets a trigger that sends NOTIFY for every row it changes. */
+    bool notifyTriggers = false;
+
 protected:
+    void readOptions();
     void generateTo(const std::string & filename);
-    void generateForTable(std::ofstream &, const Table &);
+    void generateForTable(std::ostream &, const Table &);
 
-    std::ofstream & generateDefinitionFor(std::ofstream &, const Column &);
+    std::ostream & generateDefinitionFor(std::ostream &, const Column &);
 
-    void generateForeignKeys(std::ofstream &, const Table &);
-    void generateIndexes(std::ofstream &, const Table &);
+    void generateForeignKeys(std::ostream &, const Table &);
+    void generateIndexes(std::ostream &, const Table &);
 };
 
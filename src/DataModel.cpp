@@ -49,6 +49,10 @@ void
 DataModel::fromJSON(const JSON &json)  {
     name = stringValue(json, "name");
     tables.fromJSON(jsonArray(json, "tables"));
+    tableIndex.clear();
+    for (const Table::Pointer & table: tables) {
+        indexTable(table);
+    }
     generators.fromJSON(jsonArray(json, "generators"));
     databases.fromJSON(jsonArray(json, "databases"));
     generatedVersion = intValue(json, "generatedVersion");
@@ -81,19 +85,38 @@ DataModel::createTable(const std::string &tableName) {
     tables.push_back(table);
     table->setName(tableName)
           .setDbName(camelToLower(tableName)) ;
+    indexTable(table);
     return table;
 }
 
 /**
- * Find this table.
+ * Find this table. If the index is stale because a table was renamed, we fall back
+ * to looking through them all.
  */
 const DataModel::Table::Pointer
 DataModel::findTable(const std::string &tableName) const {
+    auto iter = tableIndex.find(tableName);
+    if (iter != tableIndex.end() && iter->second->getName() == tableName) {
+        return iter->second;
+    }
     return tables.findIf( [=](const Table::Pointer &ptr){ return ptr->getName() == tableName; } );
 }
 
 void DataModel::pushTable(DataModel::Table::Pointer table) {
     tables.push_back(table);
+    indexTable(table);
+}
+
+/**
+ * Add this table to the index. If two tables have the same name, the first one
+ * wins, same as a linear search, unless the entry is for a table that's since
+ * been renamed.
+ */
+void DataModel::indexTable(const Table::Pointer &table) {
+    auto [iter, inserted] = tableIndex.emplace(table->getName(), table);
+    if (!inserted && iter->second->getName() != table->getName()) {
+        iter->second = table;
+    }
 }
 
 /**
@@ -132,6 +155,8 @@ DataModel::fixReferences() {
         }
     }
 
+    relationships = std::make_shared<const Relationships>(tables);
+
     return !errors;
 }
 
@@ -171,9 +196,8 @@ void DataModel::pushDatabase(DataModel::Database::Pointer db) {
 Column::Vector DataModel::findReferencesTo(const Table &table) {
     Column::Vector vec;
 
-    for (const Table::Pointer & thisTable: tables) {
-        Column::Vector refs = thisTable->getAllReferencesToTable(table);
-        for (const Column::Pointer &col: refs) {
+    for (const Table::Pointer & thisTable: relationships->childTables(table)) {
+        for (const Column::Pointer &col: relationships->referencesFrom(*thisTable, table)) {
             vec.push_back(col);
         }
     }
@@ -198,8 +222,14 @@ public:
     bool isString = false;
     bool isDate = false;
     bool isTimestamp = false;
+    bool wantsDictionary = false;	// Column snapshots store these as codes into a dictionary
     string lowerName;
     string cType;
+
+    // With the nativeTime option, we use nativeCType instead, and nativeName names
+    // the parse/format helpers in TimeUtilities.h: parseDate(), formatDate(), etc.
+    string nativeCType;
+    string nativeName;
 };
 
 // These two maps are reverses of each other for rapid lookup.
@@ -223,12 +253,15 @@ static DataTypeInfo stringType(string name, DataType dt, bool hasLength) {
     DataTypeInfo retVal{name, dt, "string"};
     retVal.hasLength = hasLength;
     retVal.isString = true;
+    retVal.wantsDictionary = dt != DataType::ByteArray;
     return retVal;
 }
 
 static DataTypeInfo dateType(string name, DataType dt) {
     DataTypeInfo retVal{name, dt, "string"};
     retVal.isDate = true;
+    retVal.nativeCType = "std::chrono::sys_days";
+    retVal.nativeName = "Date";
     return retVal;
 }
 
@@ -238,6 +271,13 @@ static DataTypeInfo timeType(string name, DataType dt) {
     return retVal;
 }
 
+static DataTypeInfo timestampType(string name, DataType dt) {
+    DataTypeInfo retVal = timeType(name, dt);
+    retVal.nativeCType = "std::chrono::sys_time<std::chrono::microseconds>";
+    retVal.nativeName = name;
+    return retVal;
+}
+
 static void populateMaps() {
     static std::mutex mapMutex;
     std::unique_lock<std::mutex> lock(mapMutex);
@@ -271,8 +311,8 @@ static void populateMaps() {
         vec.push_back( dateType("Date", DataType::Date) );
         vec.push_back( timeType("Time", DataType::Time) );
         vec.push_back( timeType("TimeTZ", DataType::TimeTZ) );
-        vec.push_back( timeType("Timestamp", DataType::Timestamp) );
-        vec.push_back( timeType("TimestampTZ", DataType::TimestampTZ) );
+        vec.push_back( timestampType("Timestamp", DataType::Timestamp) );
+        vec.push_back( timestampType("TimestampTZ", DataType::TimestampTZ) );
 
         for (DataTypeInfo &info: vec) {
             info.lowerName = toLower(info.name);
@@ -320,11 +360,43 @@ bool dataTypeIsSerial(DataModel::Column::DataType dt) {
 }
 
 /**
- * What underlying C++ datatype do we use?
+ * Is this a text type where values tend to repeat, so that column
+ * snapshots should dictionary-encode it?
+ */
+bool dataTypeWantsDictionary(DataModel::Column::DataType dt) {
+    populateMaps();
+    return dataTypesMap->at(dt).wantsDictionary;
+}
+
+/**
+ * What underlying C++ datatype do we use? With nativeTime, dates and timestamps
+ * are std::chrono types rather than strings. Time, TimeTZ, and Interval stay strings.
+ */
+string cTypeFor(DataModel::Column::DataType dt, bool nativeTime) {
+    populateMaps();
+    const DataTypeInfo &info = dataTypesMap->at(dt);
+    return (nativeTime && !info.nativeCType.empty()) ? info.nativeCType : info.cType;
+}
+
+/**
+ * The type of the field that holds this column. Every chrono value is a real date
+ * or time, so a nullable chrono column is a std::optional, with std::nullopt for NULL.
+ */
+string cTypeFor(const DataModel::Column &column, bool nativeTime) {
+    string cType = cTypeFor(column.getDataType(), nativeTime);
+    if (column.getNullable() && nativeTime && !nativeTimeNameFor(column.getDataType()).empty()) {
+        return "std::optional<" + cType + ">";
+    }
+    return cType;
+}
+
+/**
+ * For types with a nativeTime representation, the suffix of the TimeUtilities.h
+ * helpers that convert it (Date for parseDate() and formatDate()). Otherwise empty.
  */
-string cTypeFor(DataModel::Column::DataType dt) {
+string nativeTimeNameFor(DataModel::Column::DataType dt) {
     populateMaps();
-    return dataTypesMap->at(dt).cType;
+    return dataTypesMap->at(dt).nativeName;
 }
 
 std::vector<std::pair<std::string, DataModel::Column::DataType>> & allDataTypes() {
@@ -356,6 +428,28 @@ DataModel::Column::Column(Table::Pointer t, DataType dt)
 DataModel::Column::~Column() {
 }
 
+/**
+ * Set our name. Our table indexes us by name, so it needs to know.
+ */
+DataModel::Column & DataModel::Column::setName(const std::string &value) {
+    name = value;
+    if (Table::Pointer table = ourTable.lock()) {
+        table->reindexColumns();
+    }
+    return *this;
+}
+
+/**
+ * Set whether we're the primary key. Our table caches its primary key.
+ */
+DataModel::Column & DataModel::Column::setIsPrimaryKey(bool value) {
+    isPrimaryKey = value;
+    if (Table::Pointer table = ourTable.lock()) {
+        table->reindexColumns();
+    }
+    return *this;
+}
+
 /**
  * Is these objects identical?
  */
@@ -372,6 +466,7 @@ DataModel::Column::deepEquals(const DataModel::Column &orig) const {
         && nullable == orig.nullable
         && isPrimaryKey == orig.isPrimaryKey
         && wantIndex == orig.wantIndex
+        && unique == orig.unique
         && wantFinder == orig.wantFinder
         );
 }
@@ -395,6 +490,7 @@ DataModel::Column::fromJSON(const JSON &json) {
     nullable = boolValue(json, "nullable");
     isPrimaryKey = boolValue(json, "isPrimaryKey");
     wantIndex = boolValue(json, "wantIndex");
+    unique = boolValue(json, "unique");
     wantFinder = boolValue(json, "wantFinder");
     serialize = boolValue(json, "serialize", true);
 }
@@ -425,6 +521,7 @@ JSON  DataModel::Column::toJSON() const {
     json["nullable"] = nullable;
     json["isPrimaryKey"] = isPrimaryKey;
     json["wantIndex"] = wantIndex;
+    json["unique"] = unique;
     json["wantFinder"] = wantFinder;
     json["serialize"] = serialize;
 
@@ -477,6 +574,10 @@ DataModel::Column::flagsStr() const {
         retVal = retVal + delim + "INDEX";
         delim = " ";
     }
+    if (unique) {
+        retVal = retVal + delim + "UNIQUE";
+        delim = " ";
+    }
     if (serialize) {
         retVal += delim + "SERIALIZE";
         delim = " ";
@@ -564,9 +665,11 @@ DataModel::Table::fromJSON(const JSON &json)  {
     dbName = camelToLower(stringValue(json, "dbName"));
     dbNameGenerated = stringValue(json, "dbNameGenerated");
     version = intValue(json, "version");
+    notifyTriggerGenerated = boolValue(json, "notifyTriggerGenerated");
 
     columns.populate(shared_from_this(), jsonArray(json, "columns"));
     deletedColumns.populate(shared_from_this(), jsonArray(json, "deletedColumns"));
+    reindexColumns();
 }
 
 /**
@@ -583,6 +686,9 @@ JSON  DataModel::Table::toJSON() const {
     if (version > 0) {
         json["version"] = version;
     }
+    if (notifyTriggerGenerated) {
+        json["notifyTriggerGenerated"] = true;
+    }
 
     return json;
 }
@@ -605,10 +711,13 @@ bool DataModel::Column::isTimestamp() const {
 DataModel::Column::Pointer
 DataModel::Table::createColumn(const std::string &colName, DataModel::Column::DataType dt) {
     Column::Pointer col = std::make_shared<Column>(shared_from_this(), dt);
+
+    // Set the name directly. setName() would reindex every column.
+    col->name = colName;
+    col->setDbName(camelToLower(colName));
+
     columns.push_back(col);
-    col->setName(colName)
-        .setDbName(camelToLower(colName))
-            ;
+    columnIndex.emplace(colName, col);
     return col;
 }
 
@@ -618,6 +727,7 @@ DataModel::Table::createColumn(const std::string &colName, DataModel::Column::Da
 void DataModel::Table::deleteColumn(Column::Pointer col) {
     columns.removeAll( [=](Column::Pointer c) { return c == col; } );
     deletedColumns.push_back(col);
+    reindexColumns();
 }
 
 /**
@@ -625,7 +735,8 @@ void DataModel::Table::deleteColumn(Column::Pointer col) {
  */
 const DataModel::Column::Pointer
 DataModel::Table::findColumn(const std::string &colName) const {
-    return columns.findIf( [=](const Column::Pointer &ptr){ return ptr->getName() == colName; } );
+    auto iter = columnIndex.find(colName);
+    return iter != columnIndex.end() ? iter->second : nullptr;
 }
 
 /**
@@ -633,7 +744,23 @@ DataModel::Table::findColumn(const std::string &colName) const {
  */
 const DataModel::Column::Pointer
 DataModel::Table::findPrimaryKey() const {
-    return columns.findIf( [=](const Column::Pointer &ptr){ return ptr->getIsPrimaryKey(); } );
+    return primaryKey;
+}
+
+/**
+ * Rebuild our column index and primary key. As with a linear search, the first
+ * column with a given name (or the first primary key) wins.
+ */
+void DataModel::Table::reindexColumns() {
+    columnIndex.clear();
+    primaryKey = nullptr;
+
+    for (const Column::Pointer &column: columns) {
+        columnIndex.emplace(column->getName(), column);
+        if (primaryKey == nullptr && column->getIsPrimaryKey()) {
+            primaryKey = column;
+        }
+    }
 }
 
 /**
@@ -657,10 +784,10 @@ void DataModel::Table::clearDeletedColumns() {
 }
 
 /**
- * Are we a map table for this other table?
+ * Could we be a map table at all?
  */
 bool
-DataModel::Table::looksLikeMapTableFor(const Table &other) const {
+DataModel::Table::looksLikeMapTable() const {
     // We're only a map table if:
     //		isMap is true
     //		or our name ends in _Map
@@ -682,7 +809,15 @@ DataModel::Table::looksLikeMapTableFor(const Table &other) const {
         }
     }
 
-    if (!canBeMap) {
+    return canBeMap;
+}
+
+/**
+ * Are we a map table for this other table?
+ */
+bool
+DataModel::Table::looksLikeMapTableFor(const Table &other) const {
+    if (!looksLikeMapTable()) {
         return false;
     }
 
@@ -751,6 +886,129 @@ const DataModel::Column::Vector DataModel::Table::getAllReferencesToTable(const
 
 
 
+//======================================================================
+// Relationships.
+//======================================================================
+
+/**
+ * Work out every relationship in one pass over the columns.
+ */
+DataModel::Relationships::Relationships(const Table::Vector &tables) {
+    for (size_t index = 0; index < tables.size(); ++index) {
+        nodes[tables[index].get()].position = index;
+    }
+
+    for (const Table::Pointer &from: tables) {
+        Node &fromNode = nodes[from.get()];
+        size_t foreignKeyCount = 0;
+
+        for (const Column::Pointer &column: from->getColumns()) {
+            const Column::Pointer ref = column->getReferences();
+            Table::Pointer to = ref != nullptr ? ref->getOurTable().lock() : nullptr;
+            if (to == nullptr) {
+                continue;
+            }
+
+            Node &toNode = nodes[to.get()];
+            Column::Vector &refs = fromNode.references[to.get()];
+            if (refs.empty()) {
+                fromNode.parents.push_back(to);
+                toNode.children.push_back(from);
+            }
+            refs.push_back(column);
+            ++foreignKeyCount;
+
+            if (ref == to->findPrimaryKey()
+                && (toNode.primaryKeyReferences.empty() || toNode.primaryKeyReferences.back().first != from))
+            {
+                toNode.primaryKeyReferences.push_back( {from, column} );
+            }
+        }
+
+        std::stable_sort(fromNode.parents.begin(), fromNode.parents.end(),
+            [this](const Table::Pointer &first, const Table::Pointer &second) {
+                return nodes.at(first.get()).position < nodes.at(second.get()).position;
+            } );
+
+        // A map table joins each table whose primary key it refers to with whatever else it refers to.
+        if (from->looksLikeMapTable()) {
+            for (const Table::Pointer &to: fromNode.parents) {
+                Column::Pointer toPK = to->findPrimaryKey();
+                const Column::Vector &refs = fromNode.references.at(to.get());
+                size_t toPKCount = std::count_if(refs.begin(), refs.end(),
+                    [&](const Column::Pointer &column) { return toPK != nullptr && column->getReferences() == toPK; } );
+
+                if (to != from && toPKCount > 0 && toPKCount < foreignKeyCount) {
+                    nodes[to.get()].mapTables.push_back(from);
+                }
+            }
+        }
+    }
+}
+
+const DataModel::Relationships::Node *
+DataModel::Relationships::nodeFor(const Table &table) const {
+    auto iter = nodes.find(&table);
+    return iter != nodes.end() ? &iter->second : nullptr;
+}
+
+/**
+ * The columns in from that refer to to. This is getAllReferencesToTable() without the scan.
+ */
+const DataModel::Column::Vector &
+DataModel::Relationships::referencesFrom(const Table &from, const Table &to) const {
+    static const Column::Vector empty;
+    const Node *node = nodeFor(from);
+    if (node == nullptr) {
+        return empty;
+    }
+    auto iter = node->references.find(&to);
+    return iter != node->references.end() ? iter->second : empty;
+}
+
+/**
+ * The tables this one has a foreign key to.
+ */
+const DataModel::Relationships::TableVector &
+DataModel::Relationships::parentTables(const Table &table) const {
+    static const TableVector empty;
+    const Node *node = nodeFor(table);
+    return node != nullptr ? node->parents : empty;
+}
+
+/**
+ * The tables with a foreign key to this one.
+ */
+const DataModel::Relationships::TableVector &
+DataModel::Relationships::childTables(const Table &table) const {
+    static const TableVector empty;
+    const Node *node = nodeFor(table);
+    return node != nullptr ? node->children : empty;
+}
+
+/**
+ * Each table with a column referring to this table's primary key, with the first such
+ * column. This is every non-null ourMapTableReference().
+ */
+const std::vector<DataModel::Relationships::Reference> &
+DataModel::Relationships::primaryKeyReferences(const Table &table) const {
+    static const std::vector<Reference> empty;
+    const Node *node = nodeFor(table);
+    return node != nullptr ? node->primaryKeyReferences : empty;
+}
+
+/**
+ * The other tables that looksLikeMapTableFor() this one and have an otherMapTableReference().
+ */
+const DataModel::Relationships::TableVector &
+DataModel::Relationships::mapTables(const Table &table) const {
+    static const TableVector empty;
+    const Node *node = nodeFor(table);
+    return node != nullptr ? node->mapTables : empty;
+}
+
+
+
 //======================================================================
 // Generators definitions.
 //======================================================================
@@ -1,11 +1,14 @@
 #pragma once
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <memory>
 
 #include <showlib/JSONSerializable.h>
 
+class ModelCache;
+
 class DataModel: public ShowLib::JSONSerializable
 {
 public:
@@ -117,6 +120,7 @@ public:
         bool getNullable() const { return nullable; }
         bool getIsPrimaryKey() const { return isPrimaryKey; }
         bool getWantIndex() const { return wantIndex; }
+        bool getUnique() const { return unique; }
         bool getWantFinder() const { return wantFinder; }
         bool getSerialize() const { return serialize; }
 
@@ -129,7 +133,7 @@ public:
 
         Pointer getReferences() const { return references; }
 
-        Column & setName(const std::string &value) { name = value; return *this; }
+        Column & setName(const std::string &value);
         Column & setRefPtrName(const std::string &value) { refPtrName = value; return *this; }
         Column & setReversePtrName(const std::string &value) { reversePtrName = value; return *this; }
         Column & setDbName(const std::string &value) { dbName = value; return *this; }
@@ -145,8 +149,9 @@ public:
         Column & setLength(int length) { dataLength = length; return *this; }
         Column & setPrecision(int p, int s) { precisionP = p; precisionS = s; return *this; }
         Column & setNullable(bool value) { nullable = value; return *this; }
-        Column & setIsPrimaryKey(bool value) { isPrimaryKey = value; return *this; }
+        Column & setIsPrimaryKey(bool value);
         Column & setWantIndex(bool value) { wantIndex = value; return *this; }
+        Column & setUnique(bool value) { unique = value; return *this; }
         Column & setWantFinder(bool value) { wantFinder = value; return *this; }
         Column & setSerialize(bool value) { serialize = value; return *this; }
 
@@ -160,6 +165,9 @@ public:
         bool hasDataTypeChanged() const;
 
     private:
+        friend class Table;
+        friend class ::ModelCache;
+
         /** What table contains us? */
         std::weak_ptr<Table> ourTable;
 
@@ -219,6 +227,9 @@ public:
         /** Generate an index? */
         bool wantIndex = false;
 
+        /** Must values be unique? This gets a unique index, which ON CONFLICT needs. */
+        bool unique = false;
+
         /** Generate a finder method on the vector? */
         bool wantFinder = false;
 
@@ -252,11 +263,13 @@ public:
         const std::string getDbName() const { return dbName; }
         const std::string getDbNameGenerated() const { return dbNameGenerated; }
         int getVersion() const { return version; }
+        bool getNotifyTriggerGenerated() const { return notifyTriggerGenerated; }
 
         Table & setName(const std::string &value) { name = value; return *this; }
         Table & setDbName(const std::string &value) { dbName = value; return *this; }
         Table & setDbNameGenerated(const std::string &value) { dbNameGenerated = value; return *this; }
         Table &  setVersion(const int value) { version = value; return *this; }
+        Table & setNotifyTriggerGenerated(bool value) { notifyTriggerGenerated = value; return *this; }
 
         Column::Pointer createColumn(const std::string &colName, Column::DataType dt);
         void deleteColumn(Column::Pointer);
@@ -268,15 +281,28 @@ public:
         void sortColumns();
         void clearDeletedColumns();
 
+        bool looksLikeMapTable() const;
         bool looksLikeMapTableFor(const Table &) const;
         const Column::Vector getAllReferencesToTable(const Table &) const;
         const Column::Pointer otherMapTableReference(const Table &) const;
         const Column::Pointer ourMapTableReference(const Table &) const;
 
     private:
+        friend class Column;
+        friend class ::ModelCache;
+
+        void reindexColumns();
+
         Column::Vector	columns;
         Column::Vector	deletedColumns;
 
+        /**
+         * Our columns by name, plus our primary key. Column tells us when its name or
+         * primary key flag changes, so these are always current.
+         */
+        std::unordered_map<std::string, Column::Pointer> columnIndex;
+        Column::Pointer primaryKey = nullptr;
+
         /** This is the class name within the generated code */
         std::string	name;
 
@@ -294,8 +320,59 @@ public:
 
         /** This is used for migrations. It gets set when the table is created. Columns are separate. */
         int version = 0;
+
+        /** Migrations have created this table's notify trigger. */
+        bool notifyTriggerGenerated = false;
     };
 
+    //======================================================================
+    // Foreign key relationships between tables, worked out once by
+    // fixReferences() so the generators don't keep scanning the model.
+    // Tables are listed in model order, and columns in table order, which
+    // is what a scan would give.
+    //======================================================================
+    class Relationships
+    {
+    public:
+        typedef std::shared_ptr<const Relationships> Pointer;
+        typedef std::vector<Table::Pointer> TableVector;
+
+        /** A column and the table holding it. */
+        typedef std::pair<Table::Pointer, Column::Pointer> Reference;
+
+        Relationships() = default;
+        Relationships(const Table::Vector &tables);
+
+        const Column::Vector & referencesFrom(const Table &from, const Table &to) const;
+        const TableVector & parentTables(const Table &) const;
+        const TableVector & childTables(const Table &) const;
+        const std::vector<Reference> & primaryKeyReferences(const Table &) const;
+        const TableVector & mapTables(const Table &) const;
+
+    private:
+        class Node {
+        public:
+            /** Index within the model, so we can keep parents in model order. */
+            size_t position = 0;
+
+            /** Our columns that reference each other table. */
+            std::unordered_map<const Table *, Column::Vector> references;
+
+            /** Tables we refer to, and tables that refer to us. Either includes us if we refer to ourself. */
+            TableVector parents;
+            TableVector children;
+
+            /** For each table that refers to our primary key, the first column that does. */
+            std::vector<Reference> primaryKeyReferences;
+
+            /** Other tables that look like map tables between us and a third table. */
+            TableVector mapTables;
+        };
+
+        const Node * nodeFor(const Table &) const;
+
+        std::unordered_map<const Table *, Node> nodes;
+    };
 
     //======================================================================
     // Generators.
@@ -428,7 +505,7 @@ public:
     const Table::Pointer findTable(const std::string &tableName) const;
     void sortTables();
     void sortAllColumns();
-    void clear() { tables.clear(); isDirty = false; }
+    void clear() { tables.clear(); tableIndex.clear(); isDirty = false; }
 
     const Table::Vector & getTables() const { return tables; }
     void pushTable(DataModel::Table::Pointer);
@@ -436,6 +513,9 @@ public:
     bool fixReferences();
     Column::Vector findReferencesTo(const Table &table);
 
+    /** Foreign key relationships as of the last fixReferences(). */
+    const Relationships & getRelationships() const { return *relationships; }
+
     bool getIsDirty() const { return isDirty; }
     void markDirty() { isDirty = true; }
     void markClean() { isDirty = false; }
@@ -447,10 +527,23 @@ public:
     void pushDatabase(DataModel::Database::Pointer);
 
 private:
+    friend class ::ModelCache;
+
+    void indexTable(const Table::Pointer &);
+
     std::string filename;
     std::string name;
     std::string latestMigrationName;
     Table::Vector tables;
+
+    /**
+     * Our tables by name. Tables don't know which model they're in, so a renamed table
+     * leaves a stale entry behind, and findTable() checks what it finds.
+     */
+    std::unordered_map<std::string, Table::Pointer> tableIndex;
+
+    Relationships::Pointer relationships = std::make_shared<const Relationships>();
+
     Generator::Vector generators;
     Database::Vector databases;
     bool isDirty = false;
@@ -462,7 +555,10 @@ DataModel::Column::DataType toDataType(const std::string &);
 bool dataTypeHasLength(DataModel::Column::DataType dt);
 bool dataTypeHasPrecision(DataModel::Column::DataType dt);
 bool dataTypeIsSerial(DataModel::Column::DataType dt);
-std::string cTypeFor(DataModel::Column::DataType dt);
+bool dataTypeWantsDictionary(DataModel::Column::DataType dt);
+std::string cTypeFor(DataModel::Column::DataType dt, bool nativeTime = false);
+std::string cTypeFor(const DataModel::Column &, bool nativeTime);
+std::string nativeTimeNameFor(DataModel::Column::DataType dt);
 
 std::vector<DataModel::Column::DataTypePair> & allDataTypes();
 
@@ -0,0 +1,379 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "BuildStamp.h"
+#include "ModelCache.h"
+
+using std::string;
+using Table = DataModel::Table;
+using Column = DataModel::Column;
+using Generator = DataModel::Generator;
+using Database = DataModel::Database;
+
+static const char MAGIC[8] = { 'D', 'M', 'C', 'A', 'C', 'H', 'E', '\0' };
+
+/**
+ * Bump this whenever the layout changes. The snapshot also records the build that
+ * wrote it, so a new DataModeler never reads an old one even if nobody bumps this.
+ */
+static const uint32_t FORMAT_VERSION = 3;
+
+/**
+ * Appends fixed-size values and length-prefixed strings. We only read our own
+ * snapshots back on the same machine, so native byte order is fine.
+ */
+class ModelCache::Writer {
+public:
+    template <class T>
+    void put(T value) { data.append(reinterpret_cast<const char *>(&value), sizeof(value)); }
+
+    void putString(const string &value) {
+        put<uint32_t>(value.size());
+        data.append(value);
+    }
+
+    string data;
+};
+
+/**
+ * Reads what Writer wrote, straight out of the mapped file. Running off the
+ * end sets failed rather than reading past it.
+ */
+class ModelCache::Reader {
+public:
+    Reader(const char *_data, size_t _size): data(_data), size(_size) {}
+
+    template <class T>
+    T get() {
+        T value {};
+        if (size - offset < sizeof(value)) {
+            failed = true;
+            offset = size;
+            return value;
+        }
+        memcpy(&value, data + offset, sizeof(value));
+        offset += sizeof(value);
+        return value;
+    }
+
+    string getString() {
+        uint32_t length = get<uint32_t>();
+        if (size - offset < length) {
+            failed = true;
+            offset = size;
+            return string{};
+        }
+        string value { data + offset, length };
+        offset += length;
+        return value;
+    }
+
+    const char *data;
+    size_t size;
+    size_t offset = 0;
+    bool failed = false;
+};
+
+/**
+ * model.json's cache is .model.json.cache in the same directory.
+ */
+string ModelCache::cacheFileFor(const string &modelFile) {
+    std::filesystem::path path { modelFile };
+    return (path.parent_path() / ("." + path.filename().string() + ".cache")).string();
+}
+
+/**
+ * A 64-bit FNV-1a hash of the JSON.
+ */
+uint64_t ModelCache::hashOf(const string &contents) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c: contents) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/**
+ * Load the snapshot for this model, if there is one and it matches these JSON contents.
+ * Returns false, leaving the model alone, if the caller needs to parse the JSON instead.
+ * Either way, the caller still runs fixReferences(), which finds nothing left to resolve
+ * and builds the relationship graph.
+ */
+bool ModelCache::load(const string &modelFile, const string &contents, DataModel &model) {
+    int fd = open(cacheFileFor(modelFile).c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(info.st_size);
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+
+    Reader reader { static_cast<const char *>(mapped), size };
+    DataModel cached;
+    bool ok = false;
+    if (size > sizeof(MAGIC) && memcmp(reader.data, MAGIC, sizeof(MAGIC)) == 0) {
+        reader.offset = sizeof(MAGIC);
+        ok = reader.get<uint32_t>() == FORMAT_VERSION
+            && reader.getString() == buildStamp()
+            && reader.get<uint64_t>() == hashOf(contents)
+            && read(reader, cached);
+    }
+
+    munmap(mapped, size);
+
+    if (ok) {
+        string filename = model.getFilename();
+        model = std::move(cached);
+        model.setFilename(filename);
+    }
+
+    return ok;
+}
+
+/**
+ * Write the snapshot for this model, which came from these JSON contents. We write a
+ * temporary file and rename it into place, as several DataModelers may start at once.
+ * Failing to write the cache isn't an error.
+ */
+bool ModelCache::save(const string &modelFile, const string &contents, const DataModel &model) {
+    Writer writer;
+    writer.data.append(MAGIC, sizeof(MAGIC));
+    writer.put<uint32_t>(FORMAT_VERSION);
+    writer.putString(buildStamp());
+    writer.put<uint64_t>(hashOf(contents));
+    write(writer, model);
+
+    string cacheFile = cacheFileFor(modelFile);
+    string tempName = cacheFile + "." + std::to_string(getpid()) + ".tmp";
+    {
+        std::ofstream ofs { tempName, std::ios::binary };
+        ofs << writer.data;
+        if (!ofs) {
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempName, cacheFile, error);
+    if (error) {
+        std::filesystem::remove(tempName, error);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Write the same fields the JSON holds. A foreign key is also written as the indexes
+ * of the table and column it resolved to, or -1 if it didn't.
+ */
+void ModelCache::write(Writer &writer, const DataModel &model) {
+    const Table::Vector &tables = model.tables;
+
+    // Where each column lives, for writing foreign keys.
+    std::unordered_map<const Column *, std::pair<int32_t, int32_t>> positions;
+    for (size_t tableIndex = 0; tableIndex < tables.size(); ++tableIndex) {
+        const Column::Vector &columns = tables[tableIndex]->columns;
+        for (size_t columnIndex = 0; columnIndex < columns.size(); ++columnIndex) {
+            positions.emplace(columns[columnIndex].get(), std::make_pair(tableIndex, columnIndex));
+        }
+    }
+
+    writer.putString(model.name);
+    writer.put<int32_t>(model.generatedVersion);
+
+    writer.put<uint32_t>(tables.size());
+    for (const Table::Pointer &table: tables) {
+        writer.putString(table->name);
+        writer.putString(table->dbName);
+        writer.putString(table->dbNameGenerated);
+        writer.put<int32_t>(table->version);
+        writer.put<uint8_t>(table->notifyTriggerGenerated);
+    }
+
+    auto writeColumns = [&](const Column::Vector &columns) {
+        writer.put<uint32_t>(columns.size());
+        for (const Column::Pointer &column: columns) {
+            writer.putString(column->name);
+            writer.putString(column->refPtrName);
+            writer.putString(column->reversePtrName);
+            writer.putString(column->dbName);
+            writer.put<int32_t>(static_cast<int32_t>(column->dataType));
+            writer.put<int32_t>(column->dataLength);
+            writer.put<int32_t>(column->precisionP);
+            writer.put<int32_t>(column->precisionS);
+            writer.putString(column->referenceStr);
+            writer.put<uint8_t>(column->nullable);
+            writer.put<uint8_t>(column->isPrimaryKey);
+            writer.put<uint8_t>(column->wantIndex);
+            writer.put<uint8_t>(column->unique);
+            writer.put<uint8_t>(column->wantFinder);
+            writer.put<uint8_t>(column->serialize);
+
+            std::pair<int32_t, int32_t> position { -1, -1 };
+            if (column->references != nullptr) {
+                auto iter = positions.find(column->references.get());
+                if (iter != positions.end()) {
+                    position = iter->second;
+                }
+            }
+            writer.put<int32_t>(position.first);
+            writer.put<int32_t>(position.second);
+        }
+    };
+
+    for (const Table::Pointer &table: tables) {
+        writeColumns(table->columns);
+        writeColumns(table->deletedColumns);
+    }
+
+    writer.put<uint32_t>(model.generators.size());
+    for (const Generator::Pointer &generator: model.generators) {
+        writer.putString(generator->getName());
+        writer.putString(generator->getDescription());
+        writer.putString(generator->getOutputBasePath());
+        writer.putString(generator->getOutputClassPath());
+        writer.put<uint32_t>(generator->getOptions().size());
+        for (auto const & [key, value] : generator->getOptions()) {
+            writer.putString(key);
+            writer.putString(value);
+        }
+    }
+
+    writer.put<uint32_t>(model.databases.size());
+    for (const Database::Pointer &database: model.databases) {
+        writer.putString(database->getEnvName());
+        writer.putString(database->getDriver());
+        writer.putString(database->getHost());
+        writer.put<int32_t>(database->getPort());
+        writer.putString(database->getDbName());
+        writer.putString(database->getUsername());
+        writer.putString(database->getPassword());
+    }
+}
+
+/**
+ * The reverse of write(). Tables are all created before any columns so foreign keys
+ * can point forward. Returns false if the snapshot is damaged.
+ */
+bool ModelCache::read(Reader &reader, DataModel &model) {
+    model.name = reader.getString();
+    model.generatedVersion = reader.get<int32_t>();
+
+    uint32_t tableCount = reader.get<uint32_t>();
+    for (uint32_t index = 0; index < tableCount && !reader.failed; ++index) {
+        Table::Pointer table = std::make_shared<Table>();
+        table->name = reader.getString();
+        table->dbName = reader.getString();
+        table->dbNameGenerated = reader.getString();
+        table->version = reader.get<int32_t>();
+        table->notifyTriggerGenerated = reader.get<uint8_t>();
+        model.tables.push_back(table);
+    }
+
+    // Foreign keys can point at later tables, so we resolve them once everything is read.
+    std::vector<std::tuple<Column::Pointer, int32_t, int32_t>> references;
+
+    auto readColumns = [&](const Table::Pointer &table, Column::Vector &columns) {
+        uint32_t columnCount = reader.get<uint32_t>();
+        for (uint32_t index = 0; index < columnCount && !reader.failed; ++index) {
+            Column::Pointer column = std::make_shared<Column>(table);
+            column->name = reader.getString();
+            column->refPtrName = reader.getString();
+            column->reversePtrName = reader.getString();
+            column->dbName = reader.getString();
+            column->dataType = static_cast<Column::DataType>(reader.get<int32_t>());
+            column->dataLength = reader.get<int32_t>();
+            column->precisionP = reader.get<int32_t>();
+            column->precisionS = reader.get<int32_t>();
+            column->referenceStr = reader.getString();
+            column->nullable = reader.get<uint8_t>();
+            column->isPrimaryKey = reader.get<uint8_t>();
+            column->wantIndex = reader.get<uint8_t>();
+            column->unique = reader.get<uint8_t>();
+            column->wantFinder = reader.get<uint8_t>();
+            column->serialize = reader.get<uint8_t>();
+
+            int32_t tableIndex = reader.get<int32_t>();
+            int32_t columnIndex = reader.get<int32_t>();
+            if (tableIndex >= 0) {
+                references.emplace_back(column, tableIndex, columnIndex);
+            }
+            columns.push_back(column);
+        }
+    };
+
+    for (const Table::Pointer &table: model.tables) {
+        readColumns(table, table->columns);
+        readColumns(table, table->deletedColumns);
+        table->reindexColumns();
+    }
+    if (reader.failed) {
+        return false;
+    }
+
+    for (auto const & [column, tableIndex, columnIndex] : references) {
+        if (static_cast<size_t>(tableIndex) >= model.tables.size()
+            || columnIndex < 0
+            || static_cast<size_t>(columnIndex) >= model.tables.at(tableIndex)->columns.size())
+        {
+            return false;
+        }
+        column->references = model.tables.at(tableIndex)->columns.at(columnIndex);
+    }
+
+    uint32_t generatorCount = reader.get<uint32_t>();
+    for (uint32_t index = 0; index < generatorCount && !reader.failed; ++index) {
+        Generator::Pointer generator = std::make_shared<Generator>();
+        generator->setName(reader.getString());
+        generator->setDescription(reader.getString());
+        generator->setOutputBasePath(reader.getString());
+        generator->setOutputClassPath(reader.getString());
+
+        uint32_t optionCount = reader.get<uint32_t>();
+        for (uint32_t optionIndex = 0; optionIndex < optionCount && !reader.failed; ++optionIndex) {
+            string key = reader.getString();
+            generator->setOption(key, reader.getString());
+        }
+        model.generators.push_back(generator);
+    }
+
+    uint32_t databaseCount = reader.get<uint32_t>();
+    for (uint32_t index = 0; index < databaseCount && !reader.failed; ++index) {
+        Database::Pointer database = std::make_shared<Database>();
+        database->setEnvName(reader.getString());
+        database->setDriver(reader.getString());
+        database->setHost(reader.getString());
+        database->setPort(reader.get<int32_t>());
+        database->setDbName(reader.getString());
+        database->setUsername(reader.getString());
+        database->setPassword(reader.getString());
+        model.databases.push_back(database);
+    }
+
+    for (const Table::Pointer &table: model.tables) {
+        model.indexTable(table);
+    }
+
+    return !reader.failed && reader.offset == reader.size;
+}
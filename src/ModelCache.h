@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "DataModel.h"
+
+/**
+ * A binary snapshot of a model with its references already resolved, so large models
+ * load without parsing the JSON. The snapshot sits next to the model as
+ * .<model file>.cache and is keyed by a hash of the JSON, which stays the source of
+ * truth, and by the build of DataModeler that wrote it: if either changes, the
+ * snapshot is ignored and rewritten.
+ *
+ * The snapshot is mapped into memory and read in place. It's safe to delete.
+ */
+class ModelCache
+{
+public:
+    static std::string cacheFileFor(const std::string &modelFile);
+    static uint64_t hashOf(const std::string &contents);
+
+    static bool load(const std::string &modelFile, const std::string &contents, DataModel &);
+    static bool save(const std::string &modelFile, const std::string &contents, const DataModel &);
+
+private:
+    class Reader;
+    class Writer;
+
+    static void write(Writer &, const DataModel &);
+    static bool read(Reader &, DataModel &);
+};
@@ -0,0 +1,79 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include <unistd.h>
+
+#include <showlib/FileUtilities.h>
+
+#include "OutputFile.h"
+
+using std::cerr;
+using std::endl;
+
+thread_local std::vector<std::string> * OutputFile::recording = nullptr;
+
+OutputFile::OutputFile(const std::string &_fileName)
+    : fileName(_fileName)
+{
+    if (recording != nullptr) {
+        recording->push_back(fileName);
+    }
+}
+
+OutputFile::~OutputFile() {
+    close();
+}
+
+/**
+ * Write the file if it's new or different. We write a temporary file and rename
+ * it into place, so a reader never sees half a file. The temporary name carries our
+ * pid, so two runs writing the same tree don't clobber each other's. Returns true if we wrote.
+ */
+bool OutputFile::close() {
+    if (closed) {
+        return false;
+    }
+    closed = true;
+
+    std::string contents = str();
+    std::error_code error;
+
+    if (std::filesystem::exists(fileName, error)
+        && std::filesystem::file_size(fileName, error) == contents.size()
+        && ShowLib::FileUtilities::readFile(fileName) == contents)
+    {
+        return false;
+    }
+
+    std::string tempName = fileName + "." + std::to_string(getpid()) + ".tmp";
+    {
+        std::ofstream ofs{tempName, std::ios::binary};
+        ofs << contents;
+        if (!ofs) {
+            cerr << "Can't write " << tempName << endl;
+            ofs.close();
+            std::filesystem::remove(tempName, error);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(tempName, fileName, error);
+    if (error) {
+        cerr << "Can't replace " << fileName << ": " << error.message() << endl;
+        std::filesystem::remove(tempName, error);
+        return false;
+    }
+
+    return true;
+}
+
+OutputFile::Recorder::Recorder(std::vector<std::string> &fileNames)
+    : previous(recording)
+{
+    recording = &fileNames;
+}
+
+OutputFile::Recorder::~Recorder() {
+    recording = previous;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * The generators write through this instead of std::ofstream. Output collects in
+ * memory, and when the OutputFile is closed or destroyed we replace the file only
+ * if the contents changed. Unchanged files keep their mtime, so make doesn't
+ * rebuild everything after each generate.
+ */
+class OutputFile: public std::ostringstream
+{
+public:
+    OutputFile(const std::string &_fileName);
+    ~OutputFile();
+
+    bool close();
+
+    /**
+     * While one of these is in scope, every OutputFile this thread opens adds its
+     * name to the list. That's how forEachTable() learns which files a table wrote.
+     */
+    class Recorder {
+    public:
+        Recorder(std::vector<std::string> &fileNames);
+        ~Recorder();
+
+    private:
+        std::vector<std::string> * previous;
+    };
+
+private:
+    static thread_local std::vector<std::string> * recording;
+
+    std::string fileName;
+    bool closed = false;
+};
@@ -1,5 +1,8 @@
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <thread>
+#include <vector>
 
 #include <showlib/CommonUsing.h>
 #include <showlib/FileUtilities.h>
@@ -10,7 +13,9 @@
 #include "CodeGenerator_DB.h"
 #include "CodeGenerator_Java.h"
 #include "CodeGenerator_Flyway.h"
+#include "ModelCache.h"
 #include "Processor.h"
+#include "ThreadPool.h"
 
 using namespace ShowLib;
 
@@ -25,9 +30,15 @@ Processor & Processor::setFileName(const std::string &value) {
 
     string contents = FileUtilities::readFile(fileName);
     if (contents.length() > 0) {
-        JSON json = JSON::parse(contents);
-        model.fromJSON(json);
-        model.fixReferences();
+        if (ModelCache::load(fileName, contents, model)) {
+            model.fixReferences();
+        }
+        else {
+            JSON json = JSON::parse(contents);
+            model.fromJSON(json);
+            model.fixReferences();
+            ModelCache::save(fileName, contents, model);
+        }
     }
 
     return *this;
@@ -63,9 +74,17 @@ void Processor::listGenerators() {
 }
 
 /**
- * Perform code generation.
+ * Perform code generation. Flyway runs first, on its own, because it updates the
+ * model with what it generated. After that the model is read-only, and the other
+ * generators (and their tables) run in parallel, up to jobs threads.
  */
 void Processor::generate() {
+    if (jobs <= 0) {
+        jobs = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    ThreadPool pool { jobs };
+    std::vector<Generator::Pointer> generators;
+
     for (const Generator::Pointer & generator: model.getGenerators()) {
         string name = generator->getName();
 
@@ -73,25 +92,49 @@ void Processor::generate() {
             continue;
         }
 
-        if (name == Generator::NAME_SQL) {
-            CodeGenerator_SQL sqlGen(model, generator);
-            sqlGen.generate();
-        }
-        else if (name == Generator::NAME_CPP) {
-            CodeGenerator_CPP cppGen(model, generator);
-            cppGen.generate();
+        if (name == Generator::NAME_FLYWAY) {
+            runGenerator(generator, &pool);
         }
-        else if (name == Generator::NAME_CPP_DBACCESS) {
-            CodeGenerator_DB dbGen(model, generator);
-            dbGen.generate();
-        }
-        else if (name == Generator::NAME_JAVA) {
-            CodeGenerator_Java javaGen(model, generator);
-            javaGen.generate();
-        }
-        else if (name == Generator::NAME_FLYWAY) {
-            CodeGenerator_Flyway flywayGen(model, generator);
-            flywayGen.generate();
+        else {
+            generators.push_back(generator);
         }
     }
+
+    pool.forEach(generators.size(), [&](size_t index) { runGenerator(generators[index], &pool); });
+}
+
+/**
+ * Run this one generator.
+ */
+void Processor::runGenerator(const Generator::Pointer &generator, ThreadPool *pool) {
+    string name = generator->getName();
+
+    if (name == Generator::NAME_SQL) {
+        CodeGenerator_SQL sqlGen(model, generator);
+        sqlGen.threadPool = pool;
+        sqlGen.force = force;
+        sqlGen.generate();
+    }
+    else if (name == Generator::NAME_CPP) {
+        CodeGenerator_CPP cppGen(model, generator);
+        cppGen.threadPool = pool;
+        cppGen.force = force;
+        cppGen.generate();
+    }
+    else if (name == Generator::NAME_CPP_DBACCESS) {
+        CodeGenerator_DB dbGen(model, generator);
+        dbGen.threadPool = pool;
+        dbGen.force = force;
+        dbGen.generate();
+    }
+    else if (name == Generator::NAME_JAVA) {
+        CodeGenerator_Java javaGen(model, generator);
+        javaGen.threadPool = pool;
+        javaGen.force = force;
+        javaGen.generate();
+    }
+    else if (name == Generator::NAME_FLYWAY) {
+        CodeGenerator_Flyway flywayGen(model, generator);
+        flywayGen.generate();
+    }
 }
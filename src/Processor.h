@@ -5,6 +5,8 @@
 #include <showlib/StringVector.h>
 #include "DataModel.h"
 
+class ThreadPool;
+
 /**
  * This is the DataModeler's main processor.
  */
@@ -12,6 +14,8 @@ class Processor
 {
 public:
     Processor & setFileName(const std::string &value);
+    Processor & setJobs(int value) { jobs = value; return *this; }
+    Processor & setForce(bool value) { force = value; return *this; }
 
     void listGenerators();
     void writeModel();
@@ -19,9 +23,17 @@ public:
     void addGenerator(const std::string &genName);
 
 private:
+    void runGenerator(const DataModel::Generator::Pointer &, ThreadPool *);
+
     std::string		fileName;
     DataModel		model;
 
+    /** How many threads generate() may use. */
+    int				jobs = 1;
+
+    /** Regenerate tables even if they haven't changed. */
+    bool			force = false;
+
     ShowLib::StringVector generatorNames;
 };
 
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <exception>
+
+#include "ThreadPool.h"
+
+/** Which of our workers this thread is, if it is one. */
+static thread_local ThreadPool * currentPool = nullptr;
+static thread_local size_t currentIndex = 0;
+
+/**
+ * Start threadCount - 1 workers. The thread calling forEach() is the last one.
+ */
+ThreadPool::ThreadPool(int _threadCount)
+    : threadCount(std::max(1, _threadCount))
+{
+    for (int index = 0; index < threadCount; ++index) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (int index = 1; index < threadCount; ++index) {
+        threads.emplace_back([this, index] { workerLoop(index); });
+    }
+}
+
+/**
+ * Stop the workers. forEach() doesn't return with work outstanding, so the queues are empty.
+ */
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock { wakeMutex };
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (std::thread &thread: threads) {
+        thread.join();
+    }
+}
+
+/**
+ * Call fn(0) through fn(count - 1), spread across the pool, and return when they're
+ * all done. If any of them throws, we rethrow the first exception once they finish.
+ */
+void ThreadPool::forEach(size_t count, const std::function<void(size_t)> &fn) {
+    if (threads.empty() || count < 2) {
+        for (size_t index = 0; index < count; ++index) {
+            fn(index);
+        }
+        return;
+    }
+
+    class Group {
+    public:
+        std::atomic<size_t> remaining;
+        std::mutex errorMutex;
+        std::exception_ptr error;
+    };
+    std::shared_ptr<Group> group = std::make_shared<Group>();
+    group->remaining = count;
+
+    for (size_t index = 0; index < count; ++index) {
+        push([this, group, &fn, index] {
+            try {
+                fn(index);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock { group->errorMutex };
+                if (!group->error) {
+                    group->error = std::current_exception();
+                }
+            }
+
+            if (group->remaining.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock { wakeMutex };
+                wake.notify_all();
+            }
+        });
+    }
+
+    // Help out until our group is finished. The tasks we run may belong to someone else.
+    size_t home = currentPool == this ? currentIndex : 0;
+    while (group->remaining.load() > 0) {
+        if (!runOne(home)) {
+            std::unique_lock<std::mutex> lock { wakeMutex };
+            wake.wait(lock, [&] { return group->remaining.load() == 0 || queued.load() > 0; });
+        }
+    }
+
+    if (group->error) {
+        std::rethrow_exception(group->error);
+    }
+}
+
+/**
+ * Queue a task. From a worker it goes on that worker's own queue, which is where the
+ * worker looks first; otherwise we spread tasks across the queues.
+ */
+void ThreadPool::push(Task task) {
+    size_t index = currentPool == this ? currentIndex : nextQueue.fetch_add(1) % queues.size();
+    Queue &queue = *queues[index];
+    {
+        std::lock_guard<std::mutex> lock { queue.mutex };
+        queue.tasks.push_back(std::move(task));
+    }
+    ++queued;
+
+    std::lock_guard<std::mutex> lock { wakeMutex };
+    wake.notify_all();
+}
+
+/**
+ * Run one task: the newest from our own queue, or else the oldest from another.
+ * Returns false if there was nothing to do.
+ */
+bool ThreadPool::runOne(size_t home) {
+    Task task;
+
+    for (size_t offset = 0; offset < queues.size() && !task; ++offset) {
+        Queue &queue = *queues[(home + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock { queue.mutex };
+
+        if (!queue.tasks.empty()) {
+            if (offset == 0) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
+            else {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+        }
+    }
+
+    if (!task) {
+        return false;
+    }
+
+    --queued;
+    task();
+    return true;
+}
+
+/**
+ * Each worker runs tasks until the pool shuts down, sleeping while there are none.
+ */
+void ThreadPool::workerLoop(size_t index) {
+    currentPool = this;
+    currentIndex = index;
+
+    for (;;) {
+        if (runOne(index)) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock { wakeMutex };
+        wake.wait(lock, [&] { return stopping || queued.load() > 0; });
+        if (stopping && queued.load() == 0) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A small work-stealing thread pool for code generation. Each worker has its own
+ * queue. A worker takes tasks from the back of its own queue, and when that's empty,
+ * steals from the front of the others.
+ *
+ * forEach() can be called from inside a task. The caller runs queued tasks while it
+ * waits, so generators can fan out over tables while the generators themselves are
+ * running in parallel.
+ */
+class ThreadPool
+{
+public:
+    using Task = std::function<void()>;
+
+    /** With a threadCount of 1 (or less) there are no workers and forEach() just loops. */
+    ThreadPool(int threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool & operator=(const ThreadPool &) = delete;
+
+    int getThreadCount() const { return threadCount; }
+
+    void forEach(size_t count, const std::function<void(size_t)> &fn);
+
+private:
+    class Queue {
+    public:
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void push(Task task);
+    bool runOne(size_t home);
+    void workerLoop(size_t index);
+
+    int threadCount;
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> nextQueue { 0 };
+
+    /** Tasks sitting in any queue. Sleeping threads wait for this to be non-zero. */
+    std::atomic<int> queued { 0 };
+
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
@@ -26,6 +26,8 @@ int main(int argc, char **argv)
     args.addNoArg("gen",        [&](const char *){ doGenerate = true; }, "Shortcut for --generate");
     args.addNoArg("listgen",    [&](const char *){ doListGen = true; }, "List the configured generators");
     args.addArg  ("model",      [&](const char *arg){ processor.setFileName(arg); }, "fname", "Specify the input/output data model file");
+    args.addNoArg("force",      [&](const char *){ processor.setForce(true); }, "Regenerate tables even if they haven't changed");
+    args.addArg  ("jobs",       [&](const char *arg){ processor.setJobs(atoi(arg)); }, "n", "Generate with n threads (0 for one per core)");
 
     args.addNoArg("flyway",     [&](const char *){ processor.addGenerator(Generator::NAME_FLYWAY); }, "To limit which generators to run");
     args.addNoArg("sql",        [&](const char *){ processor.addGenerator(Generator::NAME_SQL); }, "To limit which generators to run");
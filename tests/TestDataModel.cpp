@@ -1,3 +1,6 @@
+#include <filesystem>
+
+#include "ModelCache.h"
 #include "TestDataModel.h"
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TestDataModel);
@@ -34,3 +37,118 @@ TestDataModel::testBasic() {
     CPPUNIT_ASSERT(table != nullptr);
 
 }
+
+/**
+ * findTable(), findColumn() and findPrimaryKey() use indexes. Make sure they follow renames.
+ */
+void
+TestDataModel::testLookup() {
+    DataModel dm;
+
+    Table::Pointer memberTable = dm.createTable("members");
+    Column::Pointer memberId = memberTable->createColumn("id", DataModel::Column::DataType::Serial);
+    Column::Pointer username = memberTable->createColumn("username", DataModel::Column::DataType::VarChar);
+
+    CPPUNIT_ASSERT(dm.findTable("members") == memberTable);
+    CPPUNIT_ASSERT(memberTable->findColumn("username") == username);
+    CPPUNIT_ASSERT(memberTable->findPrimaryKey() == nullptr);
+
+    memberId->setIsPrimaryKey(true);
+    CPPUNIT_ASSERT(memberTable->findPrimaryKey() == memberId);
+
+    username->setName("login");
+    CPPUNIT_ASSERT(memberTable->findColumn("username") == nullptr);
+    CPPUNIT_ASSERT(memberTable->findColumn("login") == username);
+
+    memberTable->deleteColumn(username);
+    CPPUNIT_ASSERT(memberTable->findColumn("login") == nullptr);
+
+    memberTable->setName("member");
+    CPPUNIT_ASSERT(dm.findTable("members") == nullptr);
+    CPPUNIT_ASSERT(dm.findTable("member") == memberTable);
+
+    DataModel dmRead;
+    dmRead.fromJSON(dm.getJSON());
+    Table::Pointer table = dmRead.findTable("member");
+    CPPUNIT_ASSERT(table != nullptr);
+    CPPUNIT_ASSERT(table->findPrimaryKey() == table->findColumn("id"));
+}
+
+/**
+ * fixReferences() builds the relationship graph the generators use.
+ */
+void
+TestDataModel::testRelationships() {
+    DataModel dm;
+
+    Table::Pointer memberTable = dm.createTable("Member");
+    memberTable->createColumn("id", DataModel::Column::DataType::Serial)->setIsPrimaryKey(true);
+
+    Table::Pointer threadTable = dm.createTable("Thread");
+    threadTable->createColumn("id", DataModel::Column::DataType::Serial)->setIsPrimaryKey(true);
+    Column::Pointer createdBy = threadTable->createColumn("createdById", DataModel::Column::DataType::Integer);
+    createdBy->setReferenceStr("Member");
+
+    Table::Pointer tagTable = dm.createTable("Tag");
+    tagTable->createColumn("id", DataModel::Column::DataType::Serial)->setIsPrimaryKey(true);
+
+    Table::Pointer mapTable = dm.createTable("Thread_Tag_Map");
+    mapTable->createColumn("id", DataModel::Column::DataType::Serial)->setIsPrimaryKey(true);
+    Column::Pointer threadId = mapTable->createColumn("threadId", DataModel::Column::DataType::Integer);
+    threadId->setReferenceStr("Thread");
+    mapTable->createColumn("tagId", DataModel::Column::DataType::Integer)->setReferenceStr("Tag");
+
+    CPPUNIT_ASSERT(dm.fixReferences());
+    const DataModel::Relationships &relationships = dm.getRelationships();
+
+    CPPUNIT_ASSERT(relationships.childTables(*memberTable).size() == 1);
+    CPPUNIT_ASSERT(relationships.childTables(*memberTable).at(0) == threadTable);
+    CPPUNIT_ASSERT(relationships.parentTables(*threadTable).size() == 1);
+    CPPUNIT_ASSERT(relationships.referencesFrom(*threadTable, *memberTable).size() == 1);
+    CPPUNIT_ASSERT(relationships.referencesFrom(*threadTable, *memberTable).at(0) == createdBy);
+    CPPUNIT_ASSERT(relationships.referencesFrom(*memberTable, *threadTable).empty());
+
+    CPPUNIT_ASSERT(relationships.parentTables(*mapTable).size() == 2);
+    CPPUNIT_ASSERT(relationships.parentTables(*mapTable).at(0) == threadTable);
+    CPPUNIT_ASSERT(relationships.primaryKeyReferences(*threadTable).size() == 1);
+    CPPUNIT_ASSERT(relationships.primaryKeyReferences(*threadTable).at(0).second == threadId);
+
+    CPPUNIT_ASSERT(relationships.mapTables(*threadTable).size() == 1);
+    CPPUNIT_ASSERT(relationships.mapTables(*threadTable).at(0) == mapTable);
+    CPPUNIT_ASSERT(relationships.mapTables(*tagTable).size() == 1);
+    CPPUNIT_ASSERT(relationships.mapTables(*memberTable).empty());
+}
+
+/**
+ * A model read back from its binary cache matches the JSON, with references resolved.
+ */
+void
+TestDataModel::testModelCache() {
+    DataModel dm;
+
+    Table::Pointer memberTable = dm.createTable("Member");
+    memberTable->createColumn("id", DataModel::Column::DataType::Serial)->setIsPrimaryKey(true);
+    memberTable->createColumn("username", DataModel::Column::DataType::VarChar)->setLength(64).setUnique(true);
+
+    Table::Pointer threadTable = dm.createTable("Thread");
+    threadTable->createColumn("id", DataModel::Column::DataType::Serial)->setIsPrimaryKey(true);
+    threadTable->createColumn("createdById", DataModel::Column::DataType::Integer)->setReferenceStr("Member");
+    CPPUNIT_ASSERT(dm.fixReferences());
+
+    string modelFile = (std::filesystem::temp_directory_path() / "TestDataModel.json").string();
+    string contents = dm.getJSON().dump(2);
+
+    CPPUNIT_ASSERT(ModelCache::save(modelFile, contents, dm));
+
+    DataModel dmRead;
+    CPPUNIT_ASSERT(!ModelCache::load(modelFile, contents + " ", dmRead));
+    CPPUNIT_ASSERT(ModelCache::load(modelFile, contents, dmRead));
+    CPPUNIT_ASSERT(dmRead.fixReferences());
+    CPPUNIT_ASSERT(dmRead.deepEquals(dm));
+    CPPUNIT_ASSERT(dmRead.getJSON().dump() == dm.getJSON().dump());
+
+    Table::Pointer thread = dmRead.findTable("Thread");
+    CPPUNIT_ASSERT(thread->findColumn("createdById")->getReferences() == dmRead.findTable("Member")->findPrimaryKey());
+
+    std::filesystem::remove(ModelCache::cacheFileFor(modelFile));
+}
@@ -10,9 +10,15 @@ class TestDataModel: public CppUnit::TestFixture
 {
     CPPUNIT_TEST_SUITE(TestDataModel);
     CPPUNIT_TEST(testBasic);
+    CPPUNIT_TEST(testLookup);
+    CPPUNIT_TEST(testRelationships);
+    CPPUNIT_TEST(testModelCache);
     CPPUNIT_TEST_SUITE_END();
 
 public:
     void testBasic();
+    void testLookup();
+    void testRelationships();
+    void testModelCache();
 };
 
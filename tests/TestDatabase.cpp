@@ -1,8 +1,11 @@
 #include <iostream>
 #include <iomanip>
+#include <sstream>
+#include <vector>
 
 #include <pqxx/pqxx>
 
+#include "CodeGenerator_SQL.h"
 #include "TestDatabase.h"
 
 using std::cout;
@@ -112,3 +115,49 @@ TestDatabase::testNullForeignKeys() {
     pqxx::result results = populateSeries.exec_params(sqlSeries, "Test Series", universeId);
     populateSeries.commit();
 }
+
+/**
+ * Install the trigger the SQL generators write for notifyTriggers, and make sure each
+ * committed change sends the row's key, once per transaction.
+ */
+void
+TestDatabase::testNotify() {
+    connect();
+    createTable("notify_table", "id serial primary key, name text");
+
+    DataModel model;
+    DataModel::Table::Pointer table = model.createTable("notify_table");
+    table->createColumn("id", DataModel::Column::DataType::Serial)->setIsPrimaryKey(true);
+
+    std::ostringstream sql;
+    CodeGenerator_SQL::generateNotifyTrigger(sql, *table);
+    pqxx::work install {*connection};
+    install.exec(sql.str());
+    install.commit();
+
+    class Receiver: public pqxx::notification_receiver {
+    public:
+        Receiver(pqxx::connection &conn, const string &channel): pqxx::notification_receiver(conn, channel) {}
+        void operator()(const string &payload, int) override { payloads.push_back(payload); }
+
+        std::vector<string> payloads;
+    };
+    Receiver receiver { *connection, CodeGenerator::notifyChannelFor(*table) };
+
+    pqxx::work work {*connection};
+    pqxx::result results = work.exec("INSERT INTO notify_table(name) VALUES ('first') RETURNING id");
+    int id = results[0][0].as<int>();
+    work.exec_params("UPDATE notify_table SET name = 'second' WHERE id = $1", id);
+    work.exec_params("UPDATE notify_table SET name = 'third' WHERE id = $1", id);
+    work.commit();
+
+    pqxx::work remove {*connection};
+    remove.exec_params("DELETE FROM notify_table WHERE id = $1", id);
+    remove.commit();
+
+    while (receiver.payloads.size() < 3 && connection->await_notification(5, 0) > 0) {
+    }
+
+    string key = std::to_string(id);
+    CPPUNIT_ASSERT(receiver.payloads == (std::vector<string>{ "I:" + key, "U:" + key, "D:" + key }));
+}
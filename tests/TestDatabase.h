@@ -12,6 +12,7 @@ class TestDatabase: public CppUnit::TestFixture
     CPPUNIT_TEST(testDate);
     CPPUNIT_TEST(testGoodForeignKeys);
     CPPUNIT_TEST(testNullForeignKeys);
+    CPPUNIT_TEST(testNotify);
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -19,6 +20,7 @@ public:
     void testDate();
     void testGoodForeignKeys();
     void testNullForeignKeys();
+    void testNotify();
 
 private:
     void connect();